@@ -8,13 +8,21 @@
 #include <sstream>
 #include <string>
 #include <algorithm>
+#include <numeric>
+#include <iterator>
 #include <unordered_map>
+#include <unordered_set>
 #include <filesystem>
 #include <chrono>
 #include <ctime>
 #include <sys/stat.h>
+#include <unistd.h>
 #include <cstring>
 #include <cstdlib>
+#include <cmath>
+#include <thread>
+#include <optional>
+#include <stdexcept>
 
 #include "std/zip.hpp"
 #include "std/span.hpp"
@@ -23,6 +31,14 @@
 #include "math/math3d.hpp"
 #include <float.h>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KERNELS_X86
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_AVX512 __attribute__((target("avx512f,avx512bw")))
+#endif
+
 namespace fs = std::filesystem;
 
 std::string FormatFileInfo(const fs::directory_entry& entry);
@@ -41,6 +57,40 @@ enum PROGRAM_OPTIONS {
     OPTION_TEXTURE_LIST           = 0x100,
     OPTION_TEXTURE_LIST_LODS      = 0x200,
     OPTION_TEXTURE_LIST_SINGLE    = 0x400,
+    OPTION_PROBE                  = 0x800,
+    OPTION_INFO_REPORT            = 0x1000,
+    OPTION_CONVERT                = 0x2000,
+    OPTION_UNIQUE_NORMALS         = 0x4000,
+    OPTION_WELD_POINTS            = 0x8000,
+    OPTION_DROP_UNUSED_POINTS     = 0x10000,
+    OPTION_SHARP_EDGES            = 0x20000,
+    OPTION_SORT_FACES             = 0x40000,
+    OPTION_VERTEX_CACHE           = 0x80000,
+    OPTION_DECIMATE               = 0x100000,
+    OPTION_CONVEX_COMPONENTS      = 0x200000,
+    OPTION_CONVEX_HULLS           = 0x400000,
+    OPTION_DIFF                   = 0x800000,
+    OPTION_DEDUPE                 = 0x1000000,
+    OPTION_DEDUPE_REPORT          = 0x2000000,
+    OPTION_VERIFY                 = 0x4000000,
+    OPTION_LINT                   = 0x8000000,
+    OPTION_BINARIZE               = 0x10000000,
+    OPTION_SERVER                 = 0x20000000,
+    OPTION_SERVER_STRIP           = 0x40000000,
+};
+
+// Which Shape and LodShape arrays are decoded; the rest are skipped and only counted
+enum LOD_FIELDS {
+    FIELD_NONE            = 0x0,
+    FIELD_POINTS          = 0x1,  // flags, uv, positions, normals
+    FIELD_VERTEX_MAP      = 0x2,  // point to vertices, vertex to points
+    FIELD_FACES           = 0x4,
+    FIELD_SELECTIONS      = 0x8,  // named section face/vertex indices and vertex weights
+    FIELD_SELECTION_FACES = 0x10, // named section face weights and face selection indices
+    FIELD_ANIMATIONS      = 0x20,
+    FIELD_LODS            = 0x40, // build LodShape objects, otherwise the LODs are only walked over
+    FIELD_MASSES          = 0x80, // geometry LOD point masses in the shape trailer
+    FIELD_ALL             = 0xFF,
 };
 
 constexpr static uint32_t signature_mlod = 0x444f4c4d;
@@ -53,6 +103,11 @@ struct GLOBAL_VARIABLES {
     int files_total;
     std::vector<std::string> files_to_skip;
     std::vector<std::string> texture_list;
+    unsigned worker_threads;
+    float weld_epsilon;
+    std::unordered_map<uint64_t, std::vector<size_t>> model_groups; // content hash to indices in model_group_files
+    std::vector<std::vector<std::string>> model_group_files; // models with the same content, first one converted
+    std::vector<std::pair<std::string, std::string>> lint_files; // path and file info of the models queued by --lint
 } global = {
     0,
     0
@@ -61,111 +116,438 @@ struct GLOBAL_VARIABLES {
 constexpr bool starts_with(std::string_view sv, std::string_view prefix) noexcept {
 	return (sv.size() >= prefix.size() && sv.substr(0, prefix.size()) == prefix);
 }
+
+// Runs body(begin, end) over [0, count) split into contiguous chunks of at least minChunk items,
+// one chunk per worker thread; the calling thread takes the first chunk
+template <typename Body>
+void ParallelFor(size_t count, size_t minChunk, Body&& body) {
+	size_t workers = std::min<size_t>(global.worker_threads, (count + minChunk - 1u) / std::max<size_t>(minChunk, 1u));
+	if (workers <= 1u) {
+		body(size_t{0u}, count);
+		return;
+	}
+
+	const size_t chunk = (count + workers - 1u) / workers;
+	workers = (count + chunk - 1u) / chunk;
+
+	std::vector<std::thread> threads;
+	threads.reserve(workers - 1u);
+	for (size_t i = 1u; i < workers; ++i) {
+		threads.emplace_back([&body, i, chunk, count]() { body(i * chunk, std::min(count, (i + 1u) * chunk)); });
+	}
+	body(size_t{0u}, chunk);
+	for (auto& thread : threads) {
+		thread.join();
+	}
+}
+struct PointMLOD;
+struct FaceRecordMLOD;
+
+// Hot kernels, filled in once at startup by SelectKernels() with the fastest variant the CPU supports
+struct KERNEL_TABLE {
+	const char* name;
+	size_t (*lzss_decode)(const uint8_t* in, size_t inSize, uint8_t* out, size_t outSize);
+	uint32_t (*checksum)(const uint8_t* data, size_t size);
+	// indexed by only_user_value, index is either null or the point to vertex table of a merged LOD
+	void (*translate_points[2])(PointMLOD* out, const Vector3F* positions, const uint32_t* flags, const uint16_t* index,
+		size_t count, const Vector3F& center);
+	void (*gather_face_vertices)(FaceRecordMLOD* out, const uint32_t* corners, const uint32_t* firstNormals,
+		const uint32_t* vertexToPoint, const Vector2* uvs, size_t count);
+	// range checks of --lint, count the values at or above limit and the NaN or infinite floats
+	size_t (*count_out_of_range_u16)(const uint16_t* values, size_t count, uint32_t limit);
+	size_t (*count_out_of_range_u32)(const uint32_t* values, size_t count, uint32_t limit);
+	size_t (*count_non_finite)(const float* values, size_t count);
+} kernels = {};
+
 // based on https://community.bistudio.com/wiki/Compressed_LZSS_File_Format
-bool Decode(fp::span<std::byte> out, fp::file& file) {
-	int32_t outPos = 0;
-	uint32_t sum = 0u;
+// Decodes a block held in memory, returns the number of input bytes used (without the checksum) or 0 on error
+template <bool wide_copy>
+size_t lzss_decode_block(const uint8_t* in, size_t inSize, uint8_t* out, size_t outSize) {
+	size_t inPos = 0u;
+	size_t outPos = 0u;
 	uint32_t flags = 0u;
-	size_t size = out.size();
-
-	std::cerr << "[DEBUG] Iniciando Decode. Tamanho do buffer de saída: " << size << "\n";
 
-	while (size != 0) {
+	while (outPos < outSize) {
 		flags >>= 1;
 		if ((flags & 0x100) == 0) {
-			flags = file.getc() | 0xff00;
-			if (file.error() || file.eof()) {
+			if (inPos >= inSize) {
 				std::cerr << "[ERROR] Falha ao ler flags. Erro ou EOF encontrado.\n";
-				return false;
+				return 0u;
 			}
-			std::cerr << "[DEBUG] Novos flags lidos: 0x" << std::hex << flags << std::dec << "\n";
+			flags = in[inPos++] | 0xff00;
 		}
 
 		if (flags & 0x01u) {
-			const auto data = static_cast<uint8_t>(file.getc());
-			if (file.error() || file.eof()) {
+			if (inPos >= inSize) {
 				std::cerr << "[ERROR] Falha ao ler byte raw.\n";
-				return false;
+				return 0u;
 			}
-			if (outPos >= static_cast<int32_t>(out.size())) {
-				std::cerr << "[ERROR] Escrita fora dos limites do buffer (raw).\n";
-				return false;
-			}
-			sum += data;
-			out[outPos] = static_cast<std::byte>(data);
-			++outPos;
-			--size;
-
-			std::cerr << "[DEBUG] RAW Byte: 0x" << std::hex << static_cast<int>(data) << std::dec
-			          << " → posição " << outPos - 1 << "\n";
-
+			out[outPos++] = in[inPos++];
 		} else {
-			int32_t rpos = static_cast<int32_t>(file.getc());
-			int32_t rlen = static_cast<int32_t>(file.getc());
-			if (file.error() || file.eof()) {
+			if (inPos + 2u > inSize) {
 				std::cerr << "[ERROR] Falha ao ler referência (rpos/rlen).\n";
-				return false;
+				return 0u;
 			}
+			size_t rpos = in[inPos] | ((in[inPos + 1u] & 0xf0) << 4);
+			size_t rlen = (in[inPos + 1u] & 0x0f) + 3u;
+			inPos += 2u;
 
-			rpos |= (rlen & 0xf0) << 4;
-			rlen &= 0x0f;
-			rlen += 3;
-
-			std::cerr << "[DEBUG] Referência → rpos: " << rpos << ", rlen: " << rlen << "\n";
-
+			// References before the start of the output are spaces
 			while (rpos > outPos && rlen != 0u) {
-				if (outPos >= static_cast<int32_t>(out.size())) {
-					std::cerr << "[ERROR] Overflow no buffer (espaço).\n";
-					return false;
-				}
-				sum += 0x20;
-				out[outPos] = static_cast<std::byte>(0x20);
-				++outPos;
-				--size;
-				if (size == 0u) {
+				out[outPos++] = 0x20;
+				if (outPos == outSize) {
 					break;
 				}
 				--rlen;
 			}
 
-			rpos = outPos - rpos;
-			if (rpos < 0 || rpos >= static_cast<int32_t>(out.size())) {
-				std::cerr << "[ERROR] Referência inválida no buffer (rpos calculado = " << rpos << ")\n";
-				return false;
+			if (rpos > outPos || outPos - rpos >= outSize) {
+				std::cerr << "[ERROR] Referência inválida no buffer (rpos = " << rpos << ")\n";
+				return 0u;
+			}
+
+			const uint8_t* from = out + outPos - rpos;
+			uint8_t* to = out + outPos;
+			const size_t count = std::min(rlen, outSize - outPos);
+			size_t copied = 0u;
+
+#if defined(KERNELS_X86)
+			if constexpr (wide_copy) {
+				// Source and destination are at least 16 bytes apart, bytes past count are rewritten later
+				if (rpos >= 16u && outPos + 16u <= outSize) {
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(to), _mm_loadu_si128(reinterpret_cast<const __m128i*>(from)));
+					copied = std::min<size_t>(count, 16u);
+				}
 			}
+#endif
+			for (; copied < count; ++copied) {
+				to[copied] = from[copied];
+			}
+			outPos += count;
+		}
+	}
 
-			auto from = &out[rpos];
-			auto to = &out[outPos];
-			outPos += rlen;
+	return inPos;
+}
 
-			for (; rlen > 0; --rlen) {
-				if (size == 0u || to >= out.end()) {
-					std::cerr << "[WARN] Buffer final alcançado durante cópia.\n";
-					break;
+// Encodes a block that lzss_decode_block reads back, appending it to out. Matches are taken greedily, the
+// longest one found among the last maxChain positions that share the next three bytes within the window.
+void lzss_encode_block(const uint8_t* in, size_t size, std::vector<uint8_t>& out) {
+	constexpr size_t window   = 0xFFFu;
+	constexpr size_t minMatch = 3u;
+	constexpr size_t maxMatch = 0xFu + minMatch;
+	constexpr size_t maxChain = 64u;
+	constexpr size_t hashBits = 14u;
+	constexpr uint32_t none   = 0xFFFFFFFFu;
+
+	// head holds the last position of every hash, prev links each position in the window to the one before it
+	std::vector<uint32_t> head(size_t{1u} << hashBits, none);
+	std::vector<uint32_t> prev(window + 1u, none);
+	const auto hash = [in](size_t pos) {
+		const uint32_t bytes = in[pos] | in[pos + 1u] << 8 | in[pos + 2u] << 16;
+		return (bytes * 2654435761u) >> (32u - hashBits);
+	};
+	const auto insert = [&](size_t pos) {
+		if (pos + minMatch <= size) {
+			const auto h = hash(pos);
+			prev[pos & window] = head[h];
+			head[h] = static_cast<uint32_t>(pos);
+		}
+	};
+
+	out.reserve(out.size() + size + size / 8u + 1u);
+	size_t pos = 0u;
+	while (pos < size) {
+		const size_t flagPos = out.size();
+		out.push_back(0u);
+
+		for (unsigned bit = 0u; bit < 8u && pos < size; ++bit) {
+			size_t bestLength = 0u;
+			size_t bestDistance = 0u;
+			if (pos + minMatch <= size) {
+				const size_t limit = std::min(maxMatch, size - pos);
+				uint32_t candidate = head[hash(pos)];
+				for (size_t chain = 0u; candidate != none && pos - candidate <= window && chain < maxChain; ++chain) {
+					if (in[candidate + bestLength] == in[pos + bestLength]) {
+						size_t length = 0u;
+						while (length < limit && in[candidate + length] == in[pos + length]) {
+							++length;
+						}
+						if (length > bestLength) {
+							bestLength = length;
+							bestDistance = pos - candidate;
+							if (length == limit) {
+								break;
+							}
+						}
+					}
+					candidate = prev[candidate & window];
 				}
-				const auto data = *from;
-				++from;
-				sum += std::to_integer<uint8_t>(data);
-				*to = data;
-				++to;
-				--size;
+			}
+
+			if (bestLength >= minMatch) {
+				out.push_back(static_cast<uint8_t>(bestDistance & 0xFFu));
+				out.push_back(static_cast<uint8_t>(((bestDistance >> 4) & 0xF0u) | (bestLength - minMatch)));
+				for (size_t end = pos + bestLength; pos < end; ++pos) {
+					insert(pos);
+				}
+			} else {
+				out[flagPos] |= static_cast<uint8_t>(1u << bit);
+				out.push_back(in[pos]);
+				insert(pos++);
 			}
 		}
 	}
+}
+
+uint32_t checksum_scalar(const uint8_t* data, size_t size) {
+	uint32_t sum = 0u;
+	for (size_t i = 0u; i < size; ++i) {
+		sum += data[i];
+	}
+	return sum;
+}
+
+#if defined(KERNELS_X86)
+TARGET_SSE2 uint32_t checksum_sse2(const uint8_t* data, size_t size) {
+	__m128i acc = _mm_setzero_si128();
+	size_t i = 0u;
+	for (; i + 16u <= size; i += 16u) {
+		const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+		acc = _mm_add_epi64(acc, _mm_sad_epu8(bytes, _mm_setzero_si128()));
+	}
+
+	uint64_t lanes[2];
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), acc);
+	return static_cast<uint32_t>(lanes[0] + lanes[1]) + checksum_scalar(data + i, size - i);
+}
+
+TARGET_AVX2 uint32_t checksum_avx2(const uint8_t* data, size_t size) {
+	__m256i acc = _mm256_setzero_si256();
+	size_t i = 0u;
+	for (; i + 32u <= size; i += 32u) {
+		const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+		acc = _mm256_add_epi64(acc, _mm256_sad_epu8(bytes, _mm256_setzero_si256()));
+	}
+
+	uint64_t lanes[4];
+	_mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), acc);
+	return static_cast<uint32_t>(lanes[0] + lanes[1] + lanes[2] + lanes[3]) + checksum_scalar(data + i, size - i);
+}
+
+TARGET_AVX512 uint32_t checksum_avx512(const uint8_t* data, size_t size) {
+	__m512i acc = _mm512_setzero_si512();
+	size_t i = 0u;
+	for (; i + 64u <= size; i += 64u) {
+		const __m512i bytes = _mm512_loadu_si512(data + i);
+		acc = _mm512_add_epi64(acc, _mm512_sad_epu8(bytes, _mm512_setzero_si512()));
+	}
+	return static_cast<uint32_t>(_mm512_reduce_add_epi64(acc)) + checksum_scalar(data + i, size - i);
+}
+#endif
+
+template <typename T>
+size_t count_out_of_range_scalar(const T* values, size_t count, uint32_t limit) {
+	size_t bad = 0u;
+	for (size_t i = 0u; i < count; ++i) {
+		bad += values[i] >= limit ? 1u : 0u;
+	}
+	return bad;
+}
+
+size_t count_non_finite_scalar(const float* values, size_t count) {
+	size_t bad = 0u;
+	for (size_t i = 0u; i < count; ++i) {
+		bad += std::isfinite(values[i]) ? 0u : 1u;
+	}
+	return bad;
+}
+
+#if defined(KERNELS_X86)
+// SSE2 has no unsigned compares: a saturated value - (limit - 1) is zero only for the values in range,
+// and 32-bit values are compared signed after flipping their top bit
+TARGET_SSE2 size_t count_out_of_range_u16_sse2(const uint16_t* values, size_t count, uint32_t limit) {
+	if (limit == 0u || limit > 0xFFFFu) {
+		return limit == 0u ? count : 0u;
+	}
+
+	const __m128i last = _mm_set1_epi16(static_cast<int16_t>(limit - 1u));
+	size_t bad = 0u;
+	size_t i = 0u;
+	for (; i + 8u <= count; i += 8u) {
+		const __m128i above = _mm_subs_epu16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i)), last);
+		bad += 8u - __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi16(above, _mm_setzero_si128()))) / 2u;
+	}
+	return bad + count_out_of_range_scalar(values + i, count - i, limit);
+}
+
+TARGET_SSE2 size_t count_out_of_range_u32_sse2(const uint32_t* values, size_t count, uint32_t limit) {
+	if (limit == 0u) {
+		return count;
+	}
+
+	const __m128i sign = _mm_set1_epi32(INT32_MIN);
+	const __m128i last = _mm_xor_si128(_mm_set1_epi32(static_cast<int32_t>(limit - 1u)), sign);
+	size_t bad = 0u;
+	size_t i = 0u;
+	for (; i + 4u <= count; i += 4u) {
+		const __m128i value = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i)), sign);
+		bad += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(value, last))));
+	}
+	return bad + count_out_of_range_scalar(values + i, count - i, limit);
+}
+
+// x - x is NaN for both NaN and infinite x and zero otherwise
+TARGET_SSE2 size_t count_non_finite_sse2(const float* values, size_t count) {
+	size_t bad = 0u;
+	size_t i = 0u;
+	for (; i + 4u <= count; i += 4u) {
+		const __m128 value = _mm_loadu_ps(values + i);
+		bad += __builtin_popcount(_mm_movemask_ps(_mm_cmpneq_ps(_mm_sub_ps(value, value), _mm_setzero_ps())));
+	}
+	return bad + count_non_finite_scalar(values + i, count - i);
+}
+
+TARGET_AVX2 size_t count_out_of_range_u16_avx2(const uint16_t* values, size_t count, uint32_t limit) {
+	if (limit == 0u || limit > 0xFFFFu) {
+		return limit == 0u ? count : 0u;
+	}
+
+	const __m256i last = _mm256_set1_epi16(static_cast<int16_t>(limit - 1u));
+	size_t bad = 0u;
+	size_t i = 0u;
+	for (; i + 16u <= count; i += 16u) {
+		const __m256i above = _mm256_subs_epu16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i)), last);
+		bad += 16u - __builtin_popcount(_mm256_movemask_epi8(_mm256_cmpeq_epi16(above, _mm256_setzero_si256()))) / 2u;
+	}
+	return bad + count_out_of_range_u16_sse2(values + i, count - i, limit);
+}
+
+TARGET_AVX2 size_t count_out_of_range_u32_avx2(const uint32_t* values, size_t count, uint32_t limit) {
+	const __m256i bound = _mm256_set1_epi32(static_cast<int32_t>(limit));
+	size_t bad = 0u;
+	size_t i = 0u;
+	for (; i + 8u <= count; i += 8u) {
+		const __m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+		const __m256i above = _mm256_cmpeq_epi32(_mm256_max_epu32(value, bound), value);
+		bad += __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(above)));
+	}
+	return bad + count_out_of_range_u32_sse2(values + i, count - i, limit);
+}
+
+TARGET_AVX2 size_t count_non_finite_avx2(const float* values, size_t count) {
+	size_t bad = 0u;
+	size_t i = 0u;
+	for (; i + 8u <= count; i += 8u) {
+		const __m256 value = _mm256_loadu_ps(values + i);
+		bad += __builtin_popcount(_mm256_movemask_ps(_mm256_cmp_ps(_mm256_sub_ps(value, value), _mm256_setzero_ps(), _CMP_NEQ_UQ)));
+	}
+	return bad + count_non_finite_sse2(values + i, count - i);
+}
+
+TARGET_AVX512 size_t count_out_of_range_u16_avx512(const uint16_t* values, size_t count, uint32_t limit) {
+	if (limit > 0xFFFFu) {
+		return 0u;
+	}
+
+	const __m512i bound = _mm512_set1_epi16(static_cast<int16_t>(limit));
+	size_t bad = 0u;
+	size_t i = 0u;
+	for (; i + 32u <= count; i += 32u) {
+		bad += __builtin_popcount(_mm512_cmpge_epu16_mask(_mm512_loadu_si512(values + i), bound));
+	}
+	return bad + count_out_of_range_u16_avx2(values + i, count - i, limit);
+}
+
+TARGET_AVX512 size_t count_out_of_range_u32_avx512(const uint32_t* values, size_t count, uint32_t limit) {
+	const __m512i bound = _mm512_set1_epi32(static_cast<int32_t>(limit));
+	size_t bad = 0u;
+	size_t i = 0u;
+	for (; i + 16u <= count; i += 16u) {
+		bad += __builtin_popcount(_mm512_cmpge_epu32_mask(_mm512_loadu_si512(values + i), bound));
+	}
+	return bad + count_out_of_range_u32_avx2(values + i, count - i, limit);
+}
+
+TARGET_AVX512 size_t count_non_finite_avx512(const float* values, size_t count) {
+	size_t bad = 0u;
+	size_t i = 0u;
+	for (; i + 16u <= count; i += 16u) {
+		const __m512 value = _mm512_loadu_ps(values + i);
+		bad += __builtin_popcount(_mm512_cmp_ps_mask(_mm512_sub_ps(value, value), _mm512_setzero_ps(), _CMP_NEQ_UQ));
+	}
+	return bad + count_non_finite_avx2(values + i, count - i);
+}
+#endif
+
+bool Decode(fp::span<std::byte> out, fp::file& file) {
+	// Every flag byte covers 8 items and every item uses at most as many input bytes as it outputs,
+	// except a final reference cut short by the end of the block
+	const size_t maxInput = out.size() + out.size() / 8u + 16u + sizeof(uint32_t);
+	std::vector<uint8_t> input(maxInput);
+	const size_t inputSize = file.read(input.data(), input.size());
+
+	const auto output = reinterpret_cast<uint8_t*>(out.data());
+	const size_t used = kernels.lzss_decode(input.data(), inputSize, output, out.size());
+	if (used == 0u) {
+		return false;
+	}
 
 	uint32_t checkSum;
-	if (file.read(fp::to_writable_bytes(checkSum)) != sizeof(checkSum)) {
+	if (used + sizeof(checkSum) > inputSize) {
 		std::cerr << "[ERROR] Falha ao ler checksum do arquivo.\n";
 		return false;
 	}
+	std::memcpy(&checkSum, input.data() + used, sizeof(checkSum));
+	file.seek(static_cast<long>(used + sizeof(checkSum)) - static_cast<long>(inputSize), SEEK_CUR);
 
-	std::cerr << "[DEBUG] Checksum esperado: " << checkSum << ", calculado: " << sum << "\n";
+	const uint32_t sum = kernels.checksum(output, out.size());
 	if (checkSum != sum) {
 		std::cerr << "[ERROR] Checksum não confere!\n";
 	}
 	return (checkSum == sum);
 }
 
+// Writes a block that Decode() reads back, the LZSS stream followed by its checksum
+bool Encode(fp::span<const std::byte> data, fp::file& file) {
+	const auto input = reinterpret_cast<const uint8_t*>(data.data());
+	std::vector<uint8_t> output;
+	lzss_encode_block(input, data.size(), output);
+
+	const uint32_t checkSum = kernels.checksum(input, data.size());
+	return file.write(output) == output.size() && file.write(fp::to_bytes(checkSum)) == sizeof(checkSum);
+}
+
+// Walks over a compressed block of the given decoded size without storing it
+bool SkipDecode(size_t size, fp::file& file) {
+	uint32_t flags = 0u;
+
+	while (size != 0) {
+		flags >>= 1;
+		if ((flags & 0x100) == 0) {
+			flags = file.getc() | 0xff00;
+			if (file.error() || file.eof()) {
+				return false;
+			}
+		}
+
+		if (flags & 0x01u) {
+			file.getc();
+			--size;
+		} else {
+			file.getc();
+			const auto rlen = static_cast<size_t>((file.getc() & 0x0f) + 3);
+			size -= std::min(rlen, size);
+		}
+
+		if (file.error() || file.eof()) {
+			return false;
+		}
+	}
+
+	return file.skip(sizeof(uint32_t));
+}
+
 template <class T>
 constexpr inline bool has_load(
 	int, std::enable_if_t<sizeof(std::declval<T&>().Load(std::declval<fp::file&>()), bool())>* = 0) {
@@ -204,6 +586,16 @@ void SkipValue(fp::file& file) {
 	file.skip(sizeof(T));
 }
 
+template <>
+void SkipValue<std::string>(fp::file& file) {
+	while (true) {
+		const auto c = file.getc();
+		if (c=='\0' || c==EOF) {
+			break;
+		}
+	}
+}
+
 template <>
 void ReadValue(std::string& value, fp::file& file) {
 	value.clear();
@@ -249,16 +641,38 @@ void ReadArray(std::vector<T>& array, fp::file& file, Args&&... args) {
 	}
 }
 
+// Thrown instead of exiting on a model that cannot be read, when the thread asked for it
+struct ReadError : std::runtime_error {
+	using std::runtime_error::runtime_error;
+};
+
+// --lint reads each model with this set, so one broken model is reported instead of ending the run
+thread_local bool read_errors_throw = false;
+
+[[noreturn]] void ReadFailed(std::ostream& log, const std::string& message) {
+	if (read_errors_throw) {
+		throw ReadError(message);
+	}
+	log << message << std::endl;
+	exit(1);
+}
+
 template <class T>
 void ReadCompressedArray(std::vector<T>& array, fp::file& file) {
 	uint32_t size = 0;
     if (!file.read(fp::to_writable_bytes(size))) {
-        std::cerr << "[ERROR] Failed to read array size\n";
-        exit(1);
+        ReadFailed(std::cerr, "[ERROR] Failed to read array size");
+    }
+
+    if (size == 0) {
+        array.clear();
+        return;
     }
 
     const uint32_t MAX_ALLOWED_SIZE = 100 * 1024 * 1024; // 100 MB
-    if (size == 0 || size > MAX_ALLOWED_SIZE) {
+    if (size > MAX_ALLOWED_SIZE && read_errors_throw) {
+		ReadFailed(std::cerr, "[ERROR] Array size too large or invalid: " + std::to_string(size));
+	} else if (size > MAX_ALLOWED_SIZE) {
 		std::array<uint8_t, 16> header{};
 		file.read(reinterpret_cast<char*>(header.data()), header.size());
 
@@ -280,17 +694,49 @@ void ReadCompressedArray(std::vector<T>& array, fp::file& file) {
     
     if (array.size() * sizeof(T) < 1024) {
         if (!file.read(fp::as_writable_bytes(fp::span(array)))) {
-            std::cout << "Failed to read uncompressed data" << std::endl;
-            exit(1);
+            ReadFailed(std::cout, "Failed to read uncompressed data");
         }
     } else {
         if (!Decode(fp::as_writable_bytes(fp::span(array)), file)) {
-            std::cout << "Failed to decode compressed data" << std::endl;
-            exit(1);
+            ReadFailed(std::cout, "Failed to decode compressed data");
         }
     }
 }
 
+// Same layout as ReadCompressedArray expects: small arrays stay raw, the rest is LZSS encoded
+template <class T>
+void WriteCompressedArray(const std::vector<T>& array, fp::file& file) {
+	file.write(fp::to_bytes(static_cast<uint32_t>(array.size())));
+	if (array.size() * sizeof(T) < 1024) {
+		file.write(array);
+	} else {
+		Encode(fp::as_bytes(fp::span(array)), file);
+	}
+}
+
+template <class T>
+uint32_t SkipCompressedArray(fp::file& file) {
+	uint32_t size = 0;
+	if (!file.read(fp::to_writable_bytes(size))) {
+		ReadFailed(std::cerr, "[ERROR] Failed to read array size");
+	}
+
+	if (size * sizeof(T) < 1024) {
+		file.skip(size * sizeof(T));
+	} else if (!SkipDecode(size * sizeof(T), file)) {
+		ReadFailed(std::cout, "Failed to skip compressed data");
+	}
+	return size;
+}
+
+template <class T>
+uint32_t SkipArray(fp::file& file) {
+	uint32_t size = 0;
+	file.read(fp::to_writable_bytes(size));
+	file.skip(size * sizeof(T));
+	return size;
+}
+
 template <class T, class... Args>
 void ReadArraySize(std::vector<T>& array, uint32_t size, fp::file& file, Args&&... args) {
 	array.resize(size);
@@ -342,17 +788,35 @@ public:
 };
 
 struct NamedSection {
-	void Load(fp::file& file, uint32_t version = 7) {
+	void Load(fp::file& file, int fields = FIELD_ALL) {
 		ReadValue(name, file);
 		std::transform(name.begin(), name.end(), name.begin(), ::tolower);
 
-		ReadCompressedArray(faceIndices, file);
-		ReadCompressedArray(faceWeights, file);
-		ReadCompressedArray(faceSelectionIndices, file);
-		ReadValue(needSelection, file);
-		ReadCompressedArray(faceSelectionIndices2, file);
-		ReadCompressedArray(vertexIndices, file);
-		ReadCompressedArray(vertexWeights, file);
+		if (fields & FIELD_SELECTIONS) {
+			ReadCompressedArray(faceIndices, file);
+		} else {
+			SkipCompressedArray<uint16_t>(file);
+		}
+
+		if (fields & FIELD_SELECTION_FACES) {
+			ReadCompressedArray(faceWeights, file);
+			ReadCompressedArray(faceSelectionIndices, file);
+			ReadValue(needSelection, file);
+			ReadCompressedArray(faceSelectionIndices2, file);
+		} else {
+			SkipCompressedArray<uint8_t>(file);
+			SkipCompressedArray<uint32_t>(file);
+			ReadValue(needSelection, file);
+			SkipCompressedArray<uint32_t>(file);
+		}
+
+		if (fields & FIELD_SELECTIONS) {
+			ReadCompressedArray(vertexIndices, file);
+			ReadCompressedArray(vertexWeights, file);
+		} else {
+			SkipCompressedArray<uint16_t>(file);
+			SkipCompressedArray<uint8_t>(file);
+		}
 	}
 
 	std::string name;
@@ -379,9 +843,13 @@ struct NamedProperty {
 };
 
 struct AnimationPhase {
-	void Load(fp::file& file) {
+	void Load(fp::file& file, int fields = FIELD_ALL) {
 		ReadValue(time, file);
-		ReadArray(points, file);
+		if (fields & FIELD_ANIMATIONS) {
+			ReadArray(points, file);
+		} else {
+			SkipArray<Vector3F>(file);
+		}
 	}
 
 	float time;
@@ -411,8 +879,7 @@ struct Face {
 		uint16_t p_v3)
 		: flags(p_flags), textureIndex(p_textureIndex), offset(p_offset), v0(p_v0), v1(p_v1), v2(p_v2), v3(p_v3) {
 		if (!IsQuad()) {
-			std::cout << "Invalid quad" << std::endl;
-			exit(1);
+			ReadFailed(std::cout, "Invalid quad");
 		}
 	}
 
@@ -426,19 +893,52 @@ struct Face {
 	uint16_t v3;
 };
 
+// Faces of a LOD as separate arrays, with the corners already in MLOD order
+struct FaceTable {
+	static constexpr uint32_t NO_CORNER = 0xFFFFFFFFu;
+
+	std::vector<uint32_t> corners;      // four vertex indices per face, triangles end with NO_CORNER
+	std::vector<uint32_t> firstNormals; // index of the first normal of each face in MLOD
+};
+
 union LodType {
     float graphical;
     uint32_t functional;
 };
 
+// Element counts of the LodShape arrays, kept also for the skipped ones
+struct LodCounts {
+	uint32_t flags;
+	uint32_t uv;
+	uint32_t positions;
+	uint32_t normals;
+	uint32_t pointToVertices;
+	uint32_t vertexToPoints;
+	uint32_t faces;
+};
+
 class LodShape {
 public:
-	LodShape(fp::file& file) {
-		ReadCompressedArray(m_flags, file);
-		ReadCompressedArray(m_uv, file);
+	LodShape() = default; // filled in member by member by BinarizeLodMLOD
 
-		ReadArray(m_positions, file);
-		ReadArray(m_normals, file);
+	LodShape(fp::file& file, int fields = FIELD_ALL) {
+		if (fields & FIELD_POINTS) {
+			ReadCompressedArray(m_flags, file);
+			ReadCompressedArray(m_uv, file);
+
+			ReadArray(m_positions, file);
+			ReadArray(m_normals, file);
+
+			m_counts.flags     = m_flags.size();
+			m_counts.uv        = m_uv.size();
+			m_counts.positions = m_positions.size();
+			m_counts.normals   = m_normals.size();
+		} else {
+			m_counts.flags     = SkipCompressedArray<uint32_t>(file);
+			m_counts.uv        = SkipCompressedArray<Vector2>(file);
+			m_counts.positions = SkipArray<Vector3F>(file);
+			m_counts.normals   = SkipArray<Vector3F>(file);
+		}
 
 		ReadValue(m_hintsOr, file);
 		ReadValue(m_hintsAnd, file);
@@ -451,13 +951,28 @@ public:
 
 		ReadArray(m_textureNames, file);
 
-		ReadCompressedArray(m_pointToVertices, file);
-		ReadCompressedArray(m_vertexToPoints, file);
+		if (fields & FIELD_VERTEX_MAP) {
+			ReadCompressedArray(m_pointToVertices, file);
+			ReadCompressedArray(m_vertexToPoints, file);
+
+			m_counts.pointToVertices = m_pointToVertices.size();
+			m_counts.vertexToPoints  = m_vertexToPoints.size();
+		} else {
+			m_counts.pointToVertices = SkipCompressedArray<uint16_t>(file);
+			m_counts.vertexToPoints  = SkipCompressedArray<uint16_t>(file);
+		}
 		{
 			uint32_t count = 0;
 			uint32_t size = 0;
 			ReadValue(count, file);
 			ReadValue(size, file);
+			m_counts.faces = count;
+
+			if (~fields & FIELD_FACES) {
+				SkipFaces(file, count);
+				count = 0;
+			}
+
 			uint32_t offset = 0;
 			m_orignalFaces.reserve(count);
 			for (unsigned int i = 0; i < count; i++) {
@@ -489,16 +1004,17 @@ public:
 					m_orignalFaces.emplace_back(flags, textureIndex, offset, v0, v1, v2, v3);
 					offset += 2 + 4 * 2;
 				} else {
-					std::cout << "Invalid face with n " << static_cast<uint32_t>(n) << std::endl;
-					exit(1);
+					ReadFailed(std::cout, "Invalid face with n " + std::to_string(n));
 				}
 			}
+
+			BuildFaceTable();
 		}
 
 		ReadArray(m_sections, file);
-		ReadArray(m_namedSections, file);
+		ReadArray(m_namedSections, file, fields);
 		ReadArray(m_namedProperties, file);
-		ReadArray(m_animationPhases, file);
+		ReadArray(m_animationPhases, file, fields);
 
 		ReadValue(m_color, file);
 		ReadValue(m_color2, file);
@@ -516,20 +1032,117 @@ public:
 	const auto& GetUvs() const noexcept { return m_uv; }
 
 	const auto& GetOriginalFaces() const noexcept { return m_orignalFaces; }
+	const auto& GetFaceTable() const noexcept { return m_faceTable; }
 
 	const auto& GetNamedSections() const noexcept { return m_namedSections; }
 	const auto& GetNamedProperties() const noexcept { return m_namedProperties; }
 	
 	const auto& GetPointToVertices() const noexcept { return m_pointToVertices; }
 	uint16_t VertexToPoint(uint16_t vertex) const noexcept { return m_vertexToPoints[vertex]; }
+	const auto& GetVertexToPoints() const noexcept { return m_vertexToPoints; }
+
+	const auto& GetCounts() const noexcept { return m_counts; }
+
+	// Walks over a LOD stored in the file without decoding anything
+	static void Skip(fp::file& file) {
+		SkipCompressedArray<uint32_t>(file);
+		SkipCompressedArray<Vector2>(file);
+		SkipArray<Vector3F>(file);
+		SkipArray<Vector3F>(file);
+
+		file.skip(2 * sizeof(uint32_t) + 3 * sizeof(Vector3F) + sizeof(float));
+
+		uint32_t count = 0;
+		ReadValue(count, file);
+		for (uint32_t i = 0; i < count; i++) {
+			SkipValue<std::string>(file);
+		}
+
+		SkipCompressedArray<uint16_t>(file);
+		SkipCompressedArray<uint16_t>(file);
+
+		ReadValue(count, file);
+		SkipValue<uint32_t>(file);
+		SkipFaces(file, count);
+
+		// Sections
+		ReadValue(count, file);
+		file.skip(count * (3 * sizeof(uint32_t) + sizeof(int16_t) + sizeof(int)));
+
+		// Named sections
+		ReadValue(count, file);
+		for (uint32_t i = 0; i < count; i++) {
+			SkipValue<std::string>(file);
+			SkipCompressedArray<uint16_t>(file);
+			SkipCompressedArray<uint8_t>(file);
+			SkipCompressedArray<uint32_t>(file);
+			SkipValue<bool>(file);
+			SkipCompressedArray<uint32_t>(file);
+			SkipCompressedArray<uint16_t>(file);
+			SkipCompressedArray<uint8_t>(file);
+		}
+
+		// Named properties
+		ReadValue(count, file);
+		for (uint32_t i = 0; i < 2 * count; i++) {
+			SkipValue<std::string>(file);
+		}
+
+		// Animation phases
+		ReadValue(count, file);
+		for (uint32_t i = 0; i < count; i++) {
+			SkipValue<float>(file);
+			SkipArray<Vector3F>(file);
+		}
+
+		file.skip(2 * sizeof(ColorBgra) + sizeof(uint32_t));
+
+		// Proxies
+		ReadValue(count, file);
+		for (uint32_t i = 0; i < count; i++) {
+			SkipValue<std::string>(file);
+			file.skip(sizeof(Matrix4F) + 2 * sizeof(int32_t));
+		}
+	}
+
+	// Rebuilds m_faceTable from m_orignalFaces, needed after the faces change
+	void BuildFaceTable() {
+		uint32_t normalCount = 0;
+		m_faceTable.corners.clear();
+		m_faceTable.firstNormals.clear();
+		m_faceTable.corners.reserve(4u * m_orignalFaces.size());
+		m_faceTable.firstNormals.reserve(m_orignalFaces.size());
+
+		for (const auto& face : m_orignalFaces) {
+			m_faceTable.firstNormals.push_back(normalCount);
+			if (face.IsQuad()) {
+				m_faceTable.corners.insert(m_faceTable.corners.end(), {face.v1, face.v0, face.v3, face.v2});
+				normalCount += 4;
+			} else {
+				m_faceTable.corners.insert(m_faceTable.corners.end(), {face.v1, face.v0, face.v2, FaceTable::NO_CORNER});
+				normalCount += 3;
+			}
+		}
+	}
+
+	static void SkipFaces(fp::file& file, uint32_t count) {
+		for (uint32_t i = 0; i < count; i++) {
+			file.skip(sizeof(uint32_t) + sizeof(uint16_t));
+			const auto n = static_cast<uint8_t>(file.getc());
+			file.skip(n * sizeof(uint16_t));
+		}
+	}
 
 //private:
+	LodCounts m_counts;
+
 	std::vector<uint32_t> m_flags;
 	std::vector<Vector2> m_uv;
 
 	std::vector<Vector3F> m_positions;
 	std::vector<Vector3F> m_normals;
 	std::vector<Face> m_orignalFaces;
+	FaceTable m_faceTable;
 
 	std::vector<std::string> m_textureNames;
 
@@ -559,13 +1172,23 @@ public:
 
 class Shape {
 public:
-	Shape(fp::file& file) {
+	Shape() = default;
+
+	Shape(fp::file& file, int fields = FIELD_ALL) {
 		ReadValue(m_version, file);
 		ReadValue(m_lodCount, file);
 
-		m_lods.reserve(m_lodCount);
+		m_lodOffsets.reserve(m_lodCount);
+		if (fields & FIELD_LODS)
+			m_lods.reserve(m_lodCount);
+		
 		for (uint32_t lodIndex = 0; lodIndex < m_lodCount; lodIndex++) {
-			m_lods.emplace_back(file);
+			m_lodOffsets.push_back(file.tell());
+			
+			if (fields & FIELD_LODS)
+				m_lods.emplace_back(file, fields);
+			else
+				LodShape::Skip(file);
 		}
 
 		m_lodDistances.reserve(m_lodCount);
@@ -606,7 +1229,10 @@ public:
 
 		ReadValue(m_mapType, file);
 
-		ReadCompressedArray(m_masses, file);
+		if (fields & FIELD_MASSES)
+			ReadCompressedArray(m_masses, file);
+		else
+			SkipCompressedArray<float>(file);
 
 		ReadValue(m_mass, file);
 		ReadValue(m_invMass, file);
@@ -629,6 +1255,7 @@ public:
 	}
 
 	const auto& GetLods() const noexcept { return m_lods; }
+	const auto& GetLodOffsets() const noexcept { return m_lodOffsets; }
 	const auto& GetLodDistances() const noexcept { return m_lodDistances; }
 
 	const auto& GetAimPoint() const noexcept { return m_aimPoint; }
@@ -663,6 +1290,7 @@ public:
 	uint32_t m_lodCount;
 
 	std::vector<LodShape> m_lods;
+	std::vector<long> m_lodOffsets;
 	std::vector<LodType> m_lodDistances;
 
 	uint32_t m_properties;
@@ -902,12 +1530,6 @@ public:
 	std::string SP3X_DefaultPath;
 };
 
-struct FaceVertex {
-	uint32_t vertexIndex;
-	uint32_t normalIndex;
-	Vector2 uv;
-};
-
 template <size_t N>
 void WriteName(fp::file& f, std::string_view name) {
 	if (name.size() >= N) {
@@ -969,10 +1591,11 @@ std::string FormatSignature(uint32_t number) {
 	return name;
 }
 
-uint32_t convert_point_light_flags(uint32_t flags_odol, bool only_user_value) {
+template <bool only_user_value>
+uint32_t convert_point_light_flags(uint32_t flags_odol) {
 	uint32_t flags_mlod = 0u;
 	
-	if (!only_user_value) {
+	if constexpr (!only_user_value) {
 		if (flags_odol >> 20 == 0xC8) flags_mlod|=0x10; //Shining
 		if (flags_odol >> 20 == 0xC9) flags_mlod|=0x20; //Always in shadow
 		if (flags_odol >> 20 == 0xCA) flags_mlod|=0x80; //Half lighted
@@ -989,32 +1612,3677 @@ uint32_t convert_point_light_flags(uint32_t flags_odol, bool only_user_value) {
 	return flags_mlod;
 }
 
-int Parse_P3D(std::string filename_input, std::string file_info, int &options) {
-	std::cout << filename_input << std::endl;
-	fp::file file(filename_input, "rb");
+// Reverse of convert_point_light_flags, the clip flags of ODOL are not kept in MLOD
+uint32_t convert_point_light_flags_to_odol(uint32_t flags_mlod) {
+	uint32_t flags_odol = 0u;
 	
-	if (!file.is_open()) {
-		std::cout << "Failed to open - error " << errno << ": " << strerror(errno) << std::endl;
-		return 1;
+	if (flags_mlod & 0x10) flags_odol = 0xC8u << 20; //Shining
+	else if (flags_mlod & 0x20) flags_odol = 0xC9u << 20; //Always in shadow
+	else if (flags_mlod & 0x80) flags_odol = 0xCAu << 20; //Half lighted
+	else if (flags_mlod & 0x40) flags_odol = 0xCBu << 20; //Fully lighted
+	else flags_odol = (flags_mlod & 0xFF0000) << 4; //User value
+	
+	flags_odol |= (flags_mlod & 0xF) << 8; //Surface
+	flags_odol |= (flags_mlod & 0x300) << 4; //Decal
+	flags_odol |= (flags_mlod & 0x3000) << 2; //Fog
+	
+	return flags_odol;
+}
+
+// Writes positions moved by the LOD center together with the converted flags into the PointMLOD layout,
+// index picks the source points of a merged LOD
+template <bool only_user_value>
+void translate_points_scalar(PointMLOD* out, const Vector3F* positions, const uint32_t* flags, const uint16_t* index,
+	size_t count, const Vector3F& center) {
+	for (size_t i = 0u; i < count; ++i) {
+		const size_t source = index ? index[i] : i;
+		out[i].pos = positions[source] + center;
+		out[i].flags = convert_point_light_flags<only_user_value>(flags[source]);
 	}
+}
+
+#if defined(KERNELS_X86)
+// Four point flags at once, same bit shuffling as convert_point_light_flags
+template <bool only_user_value>
+TARGET_SSE2 inline __m128i convert_point_light_flags_sse2(__m128i flags_odol) {
+	const __m128i user = _mm_and_si128(_mm_srli_epi32(flags_odol, 4), _mm_set1_epi32(0xFF0000)); //User value
+	__m128i flags_mlod = user;
 	
-	// Verify file type
-	uint32_t current_file_signature;
-	ReadValue(current_file_signature, file);
+	if constexpr (!only_user_value) {
+		const __m128i light = _mm_srli_epi32(flags_odol, 20);
+		const __m128i shining = _mm_cmpeq_epi32(light, _mm_set1_epi32(0xC8));
+		const __m128i shadow = _mm_cmpeq_epi32(light, _mm_set1_epi32(0xC9));
+		const __m128i half = _mm_cmpeq_epi32(light, _mm_set1_epi32(0xCA));
+		const __m128i full = _mm_cmpeq_epi32(light, _mm_set1_epi32(0xCB));
+		const __m128i lighting = _mm_or_si128(
+			_mm_or_si128(_mm_and_si128(shining, _mm_set1_epi32(0x10)), _mm_and_si128(shadow, _mm_set1_epi32(0x20))),
+			_mm_or_si128(_mm_and_si128(half, _mm_set1_epi32(0x80)), _mm_and_si128(full, _mm_set1_epi32(0x40))));
+		const __m128i is_lighting = _mm_or_si128(_mm_or_si128(shining, shadow), _mm_or_si128(half, full));
+		flags_mlod = _mm_or_si128(lighting, _mm_andnot_si128(is_lighting, user));
+	}
 	
-	if (current_file_signature!=signature_odol  &&  current_file_signature!=signature_mlod) {
-		file.close();
-		std::cout << "Incorrect file type " << FormatSignature(current_file_signature) << std::endl;
-		return 2;
+	flags_mlod = _mm_or_si128(flags_mlod, _mm_and_si128(_mm_srli_epi32(flags_odol, 8), _mm_set1_epi32(0xF))); //Surface
+	flags_mlod = _mm_or_si128(flags_mlod, _mm_and_si128(_mm_srli_epi32(flags_odol, 4), _mm_set1_epi32(0x300))); //Decal
+	flags_mlod = _mm_or_si128(flags_mlod, _mm_and_si128(_mm_srli_epi32(flags_odol, 2), _mm_set1_epi32(0x3000))); //Fog
+	return flags_mlod;
+}
+
+template <bool only_user_value>
+TARGET_AVX2 inline __m256i convert_point_light_flags_avx2(__m256i flags_odol) {
+	const __m256i user = _mm256_and_si256(_mm256_srli_epi32(flags_odol, 4), _mm256_set1_epi32(0xFF0000)); //User value
+	__m256i flags_mlod = user;
+	
+	if constexpr (!only_user_value) {
+		const __m256i light = _mm256_srli_epi32(flags_odol, 20);
+		const __m256i shining = _mm256_cmpeq_epi32(light, _mm256_set1_epi32(0xC8));
+		const __m256i shadow = _mm256_cmpeq_epi32(light, _mm256_set1_epi32(0xC9));
+		const __m256i half = _mm256_cmpeq_epi32(light, _mm256_set1_epi32(0xCA));
+		const __m256i full = _mm256_cmpeq_epi32(light, _mm256_set1_epi32(0xCB));
+		const __m256i lighting = _mm256_or_si256(
+			_mm256_or_si256(_mm256_and_si256(shining, _mm256_set1_epi32(0x10)), _mm256_and_si256(shadow, _mm256_set1_epi32(0x20))),
+			_mm256_or_si256(_mm256_and_si256(half, _mm256_set1_epi32(0x80)), _mm256_and_si256(full, _mm256_set1_epi32(0x40))));
+		const __m256i is_lighting = _mm256_or_si256(_mm256_or_si256(shining, shadow), _mm256_or_si256(half, full));
+		flags_mlod = _mm256_or_si256(lighting, _mm256_andnot_si256(is_lighting, user));
 	}
 	
-	// Create output
-	std::fstream out;
-	std::ios_base::openmode mode = std::ios::out | std::ios::trunc;
-	std::string filename_output  = "";
+	flags_mlod = _mm256_or_si256(flags_mlod, _mm256_and_si256(_mm256_srli_epi32(flags_odol, 8), _mm256_set1_epi32(0xF))); //Surface
+	flags_mlod = _mm256_or_si256(flags_mlod, _mm256_and_si256(_mm256_srli_epi32(flags_odol, 4), _mm256_set1_epi32(0x300))); //Decal
+	flags_mlod = _mm256_or_si256(flags_mlod, _mm256_and_si256(_mm256_srli_epi32(flags_odol, 2), _mm256_set1_epi32(0x3000))); //Fog
+	return flags_mlod;
+}
+
+template <bool only_user_value>
+TARGET_AVX512 inline __m512i convert_point_light_flags_avx512(__m512i flags_odol) {
+	const __m512i user = _mm512_and_si512(_mm512_srli_epi32(flags_odol, 4), _mm512_set1_epi32(0xFF0000)); //User value
+	__m512i flags_mlod = user;
 	
-	if (options & OPTION_INFO) {
-		if (~options & OPTION_TEXTURE_LIST_SINGLE) {
+	if constexpr (!only_user_value) {
+		const __m512i light = _mm512_srli_epi32(flags_odol, 20);
+		const __mmask16 shining = _mm512_cmpeq_epi32_mask(light, _mm512_set1_epi32(0xC8));
+		const __mmask16 shadow = _mm512_cmpeq_epi32_mask(light, _mm512_set1_epi32(0xC9));
+		const __mmask16 half = _mm512_cmpeq_epi32_mask(light, _mm512_set1_epi32(0xCA));
+		const __mmask16 full = _mm512_cmpeq_epi32_mask(light, _mm512_set1_epi32(0xCB));
+		flags_mlod = _mm512_mask_mov_epi32(flags_mlod, shining, _mm512_set1_epi32(0x10));
+		flags_mlod = _mm512_mask_mov_epi32(flags_mlod, shadow, _mm512_set1_epi32(0x20));
+		flags_mlod = _mm512_mask_mov_epi32(flags_mlod, half, _mm512_set1_epi32(0x80));
+		flags_mlod = _mm512_mask_mov_epi32(flags_mlod, full, _mm512_set1_epi32(0x40));
+	}
+	
+	flags_mlod = _mm512_or_si512(flags_mlod, _mm512_and_si512(_mm512_srli_epi32(flags_odol, 8), _mm512_set1_epi32(0xF))); //Surface
+	flags_mlod = _mm512_or_si512(flags_mlod, _mm512_and_si512(_mm512_srli_epi32(flags_odol, 4), _mm512_set1_epi32(0x300))); //Decal
+	flags_mlod = _mm512_or_si512(flags_mlod, _mm512_and_si512(_mm512_srli_epi32(flags_odol, 2), _mm512_set1_epi32(0x3000))); //Fog
+	return flags_mlod;
+}
+
+// Every 128-bit lane below holds four points: either three loads a, b, c of packed xyz triples
+// or x, y, z gathered separately. Both end up as p0..p3 = x y z flags of the lane's points.
+#define INTERLEAVE_POINTS(suffix, a, b, c, f, p0, p1, p2, p3)                                                          \
+	p0 = _mm##suffix##_shuffle_ps(a, _mm##suffix##_shuffle_ps(a, f, _MM_SHUFFLE(0, 0, 2, 2)), _MM_SHUFFLE(2, 0, 1, 0)); \
+	p1 = _mm##suffix##_shuffle_ps(_mm##suffix##_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 3, 3)),                               \
+		_mm##suffix##_shuffle_ps(b, f, _MM_SHUFFLE(1, 1, 1, 1)), _MM_SHUFFLE(2, 0, 2, 0));                             \
+	p2 = _mm##suffix##_shuffle_ps(b, _mm##suffix##_shuffle_ps(c, f, _MM_SHUFFLE(2, 2, 0, 0)), _MM_SHUFFLE(2, 0, 3, 2)); \
+	p3 = _mm##suffix##_shuffle_ps(c, _mm##suffix##_shuffle_ps(c, f, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(2, 0, 2, 1));
+
+#define TRANSPOSE_POINTS(suffix, x, y, z, f, p0, p1, p2, p3)                      \
+	{                                                                             \
+		const auto xy_lo = _mm##suffix##_unpacklo_ps(x, y);                       \
+		const auto zf_lo = _mm##suffix##_unpacklo_ps(z, f);                       \
+		const auto xy_hi = _mm##suffix##_unpackhi_ps(x, y);                       \
+		const auto zf_hi = _mm##suffix##_unpackhi_ps(z, f);                       \
+		p0 = _mm##suffix##_shuffle_ps(xy_lo, zf_lo, _MM_SHUFFLE(1, 0, 1, 0));     \
+		p1 = _mm##suffix##_shuffle_ps(xy_lo, zf_lo, _MM_SHUFFLE(3, 2, 3, 2));     \
+		p2 = _mm##suffix##_shuffle_ps(xy_hi, zf_hi, _MM_SHUFFLE(1, 0, 1, 0));     \
+		p3 = _mm##suffix##_shuffle_ps(xy_hi, zf_hi, _MM_SHUFFLE(3, 2, 3, 2));     \
+	}
+
+TARGET_AVX2 inline __m256 load_lanes_avx2(const float* lo, const float* hi) {
+	return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(lo)), _mm_loadu_ps(hi), 1);
+}
+
+TARGET_AVX512 inline __m512 load_lanes_avx512(const float* p0, const float* p1, const float* p2, const float* p3) {
+	__m512 v = _mm512_castps128_ps512(_mm_loadu_ps(p0));
+	v = _mm512_insertf32x4(v, _mm_loadu_ps(p1), 1);
+	v = _mm512_insertf32x4(v, _mm_loadu_ps(p2), 2);
+	return _mm512_insertf32x4(v, _mm_loadu_ps(p3), 3);
+}
+
+TARGET_AVX512 inline __m512 broadcast_lanes_avx512(float a, float b, float c, float d) {
+	return _mm512_broadcast_f32x4(_mm_setr_ps(a, b, c, d));
+}
+
+template <bool only_user_value>
+TARGET_SSE2 void translate_points_sse2(PointMLOD* out, const Vector3F* positions, const uint32_t* flags,
+	const uint16_t* index, size_t count, const Vector3F& center) {
+	const auto src = reinterpret_cast<const float*>(positions);
+	const auto dst = reinterpret_cast<float*>(out);
+	size_t i = 0u;
+	
+	if (index) {
+		const __m128 cx = _mm_set1_ps(center.X());
+		const __m128 cy = _mm_set1_ps(center.Y());
+		const __m128 cz = _mm_set1_ps(center.Z());
+		
+		for (; i + 4u <= count; i += 4u) {
+			const Vector3F& v0 = positions[index[i + 0u]];
+			const Vector3F& v1 = positions[index[i + 1u]];
+			const Vector3F& v2 = positions[index[i + 2u]];
+			const Vector3F& v3 = positions[index[i + 3u]];
+			const __m128 x = _mm_add_ps(_mm_setr_ps(v0.X(), v1.X(), v2.X(), v3.X()), cx);
+			const __m128 y = _mm_add_ps(_mm_setr_ps(v0.Y(), v1.Y(), v2.Y(), v3.Y()), cy);
+			const __m128 z = _mm_add_ps(_mm_setr_ps(v0.Z(), v1.Z(), v2.Z(), v3.Z()), cz);
+			const __m128i flags_odol = _mm_setr_epi32(flags[index[i + 0u]], flags[index[i + 1u]], flags[index[i + 2u]], flags[index[i + 3u]]);
+			const __m128 f = _mm_castsi128_ps(convert_point_light_flags_sse2<only_user_value>(flags_odol));
+			
+			__m128 p0, p1, p2, p3;
+			TRANSPOSE_POINTS(, x, y, z, f, p0, p1, p2, p3)
+			
+			float* d = dst + 4u * i;
+			_mm_storeu_ps(d + 0u, p0);
+			_mm_storeu_ps(d + 4u, p1);
+			_mm_storeu_ps(d + 8u, p2);
+			_mm_storeu_ps(d + 12u, p3);
+		}
+	} else {
+		const __m128 ca = _mm_setr_ps(center.X(), center.Y(), center.Z(), center.X());
+		const __m128 cb = _mm_setr_ps(center.Y(), center.Z(), center.X(), center.Y());
+		const __m128 cc = _mm_setr_ps(center.Z(), center.X(), center.Y(), center.Z());
+		
+		for (; i + 4u <= count; i += 4u) {
+			const float* p = src + 3u * i;
+			const __m128 a = _mm_add_ps(_mm_loadu_ps(p + 0u), ca);
+			const __m128 b = _mm_add_ps(_mm_loadu_ps(p + 4u), cb);
+			const __m128 c = _mm_add_ps(_mm_loadu_ps(p + 8u), cc);
+			const __m128 f = _mm_castsi128_ps(convert_point_light_flags_sse2<only_user_value>(
+				_mm_loadu_si128(reinterpret_cast<const __m128i*>(flags + i))));
+			
+			__m128 p0, p1, p2, p3;
+			INTERLEAVE_POINTS(, a, b, c, f, p0, p1, p2, p3)
+			
+			float* d = dst + 4u * i;
+			_mm_storeu_ps(d + 0u, p0);
+			_mm_storeu_ps(d + 4u, p1);
+			_mm_storeu_ps(d + 8u, p2);
+			_mm_storeu_ps(d + 12u, p3);
+		}
+	}
+	
+	translate_points_scalar<only_user_value>(out + i, index ? positions : positions + i, index ? flags : flags + i,
+		index ? index + i : nullptr, count - i, center);
+}
+
+template <bool only_user_value>
+TARGET_AVX2 void translate_points_avx2(PointMLOD* out, const Vector3F* positions, const uint32_t* flags,
+	const uint16_t* index, size_t count, const Vector3F& center) {
+	const auto src = reinterpret_cast<const float*>(positions);
+	const auto dst = reinterpret_cast<float*>(out);
+	size_t i = 0u;
+	
+	for (; i + 8u <= count; i += 8u) {
+		__m256 p0, p1, p2, p3;
+		
+		if (index) {
+			const __m256i points = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(index + i)));
+			const __m256i floats = _mm256_add_epi32(points, _mm256_add_epi32(points, points));
+			const __m256 x = _mm256_add_ps(_mm256_i32gather_ps(src + 0, floats, 4), _mm256_set1_ps(center.X()));
+			const __m256 y = _mm256_add_ps(_mm256_i32gather_ps(src + 1, floats, 4), _mm256_set1_ps(center.Y()));
+			const __m256 z = _mm256_add_ps(_mm256_i32gather_ps(src + 2, floats, 4), _mm256_set1_ps(center.Z()));
+			const __m256i flags_odol = _mm256_i32gather_epi32(reinterpret_cast<const int*>(flags), points, 4);
+			const __m256 f = _mm256_castsi256_ps(convert_point_light_flags_avx2<only_user_value>(flags_odol));
+			TRANSPOSE_POINTS(256, x, y, z, f, p0, p1, p2, p3)
+		} else {
+			const float* p = src + 3u * i;
+			const __m256 a = _mm256_add_ps(load_lanes_avx2(p + 0u, p + 12u), _mm256_setr_ps(center.X(), center.Y(), center.Z(), center.X(), center.X(), center.Y(), center.Z(), center.X()));
+			const __m256 b = _mm256_add_ps(load_lanes_avx2(p + 4u, p + 16u), _mm256_setr_ps(center.Y(), center.Z(), center.X(), center.Y(), center.Y(), center.Z(), center.X(), center.Y()));
+			const __m256 c = _mm256_add_ps(load_lanes_avx2(p + 8u, p + 20u), _mm256_setr_ps(center.Z(), center.X(), center.Y(), center.Z(), center.Z(), center.X(), center.Y(), center.Z()));
+			const __m256 f = _mm256_castsi256_ps(convert_point_light_flags_avx2<only_user_value>(
+				_mm256_loadu_si256(reinterpret_cast<const __m256i*>(flags + i))));
+			INTERLEAVE_POINTS(256, a, b, c, f, p0, p1, p2, p3)
+		}
+		
+		// lane 0 holds points 0-3, lane 1 points 4-7
+		float* d = dst + 4u * i;
+		_mm256_storeu_ps(d + 0u, _mm256_permute2f128_ps(p0, p1, 0x20));
+		_mm256_storeu_ps(d + 8u, _mm256_permute2f128_ps(p2, p3, 0x20));
+		_mm256_storeu_ps(d + 16u, _mm256_permute2f128_ps(p0, p1, 0x31));
+		_mm256_storeu_ps(d + 24u, _mm256_permute2f128_ps(p2, p3, 0x31));
+	}
+	
+	translate_points_sse2<only_user_value>(out + i, index ? positions : positions + i, index ? flags : flags + i,
+		index ? index + i : nullptr, count - i, center);
+}
+
+template <bool only_user_value>
+TARGET_AVX512 void translate_points_avx512(PointMLOD* out, const Vector3F* positions, const uint32_t* flags,
+	const uint16_t* index, size_t count, const Vector3F& center) {
+	const auto src = reinterpret_cast<const float*>(positions);
+	const auto dst = reinterpret_cast<float*>(out);
+	size_t i = 0u;
+	
+	for (; i + 16u <= count; i += 16u) {
+		__m512 p0, p1, p2, p3;
+		
+		if (index) {
+			const __m512i points = _mm512_cvtepu16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(index + i)));
+			const __m512i floats = _mm512_add_epi32(points, _mm512_add_epi32(points, points));
+			const __m512 x = _mm512_add_ps(_mm512_i32gather_ps(floats, src + 0, 4), _mm512_set1_ps(center.X()));
+			const __m512 y = _mm512_add_ps(_mm512_i32gather_ps(floats, src + 1, 4), _mm512_set1_ps(center.Y()));
+			const __m512 z = _mm512_add_ps(_mm512_i32gather_ps(floats, src + 2, 4), _mm512_set1_ps(center.Z()));
+			const __m512i flags_odol = _mm512_i32gather_epi32(points, flags, 4);
+			const __m512 f = _mm512_castsi512_ps(convert_point_light_flags_avx512<only_user_value>(flags_odol));
+			TRANSPOSE_POINTS(512, x, y, z, f, p0, p1, p2, p3)
+		} else {
+			const float* p = src + 3u * i;
+			const __m512 a = _mm512_add_ps(load_lanes_avx512(p + 0u, p + 12u, p + 24u, p + 36u), broadcast_lanes_avx512(center.X(), center.Y(), center.Z(), center.X()));
+			const __m512 b = _mm512_add_ps(load_lanes_avx512(p + 4u, p + 16u, p + 28u, p + 40u), broadcast_lanes_avx512(center.Y(), center.Z(), center.X(), center.Y()));
+			const __m512 c = _mm512_add_ps(load_lanes_avx512(p + 8u, p + 20u, p + 32u, p + 44u), broadcast_lanes_avx512(center.Z(), center.X(), center.Y(), center.Z()));
+			const __m512 f = _mm512_castsi512_ps(convert_point_light_flags_avx512<only_user_value>(_mm512_loadu_si512(flags + i)));
+			INTERLEAVE_POINTS(512, a, b, c, f, p0, p1, p2, p3)
+		}
+		
+		// lane k of p0..p3 holds points 4k..4k+3, transpose the 128-bit blocks
+		const __m512 t0 = _mm512_shuffle_f32x4(p0, p1, 0x44);
+		const __m512 t1 = _mm512_shuffle_f32x4(p2, p3, 0x44);
+		const __m512 t2 = _mm512_shuffle_f32x4(p0, p1, 0xEE);
+		const __m512 t3 = _mm512_shuffle_f32x4(p2, p3, 0xEE);
+		float* d = dst + 4u * i;
+		_mm512_storeu_ps(d + 0u, _mm512_shuffle_f32x4(t0, t1, 0x88));
+		_mm512_storeu_ps(d + 16u, _mm512_shuffle_f32x4(t0, t1, 0xDD));
+		_mm512_storeu_ps(d + 32u, _mm512_shuffle_f32x4(t2, t3, 0x88));
+		_mm512_storeu_ps(d + 48u, _mm512_shuffle_f32x4(t2, t3, 0xDD));
+	}
+	
+	translate_points_avx2<only_user_value>(out + i, index ? positions : positions + i, index ? flags : flags + i,
+		index ? index + i : nullptr, count - i, center);
+}
+
+#undef INTERLEAVE_POINTS
+#undef TRANSPOSE_POINTS
+#endif
+
+// Distance within which -w welds points, ODOL2MLOD_WELD_EPSILON overrides the default
+void SelectWeldEpsilon() {
+	global.weld_epsilon = 0.001f;
+	if (const char* env = std::getenv("ODOL2MLOD_WELD_EPSILON")) {
+		global.weld_epsilon = std::max(static_cast<float>(std::atof(env)), 1e-6f);
+	}
+}
+
+// Worker threads for the parallel writers, ODOL2MLOD_THREADS overrides the hardware thread count
+void SelectWorkerThreads() {
+	global.worker_threads = std::max(1u, std::thread::hardware_concurrency());
+	if (const char* env = std::getenv("ODOL2MLOD_THREADS")) {
+		global.worker_threads = std::max(1, std::atoi(env));
+	}
+}
+
+// Face layout shared by all faces of a LOD, lets the face loops drop the IsQuad() test
+enum FACE_LAYOUT {
+	FACE_LAYOUT_MIXED,
+	FACE_LAYOUT_TRIANGLES,
+	FACE_LAYOUT_QUADS,
+};
+
+// On-disk face of an SP3X LOD
+struct FaceRecordMLOD {
+	std::array<char, 32u> texture;
+	uint32_t type;
+	std::array<VertexTableMLOD, 4u> vertices;
+	uint32_t flags;
+};
+static_assert(sizeof(FaceRecordMLOD) == 104u, "FaceRecordMLOD must match the SP3X face layout");
+
+// Fills the vertex tables of the face records from the face table corners,
+// vertexToPoint is either null or the vertex to point table of a merged LOD
+void gather_face_vertices_scalar(FaceRecordMLOD* out, const uint32_t* corners, const uint32_t* firstNormals,
+	const uint32_t* vertexToPoint, const Vector2* uvs, size_t count) {
+	for (size_t i = 0u; i < count; ++i) {
+		for (size_t k = 0u; k < 4u; ++k) {
+			const uint32_t corner = corners[4u * i + k];
+			auto& vertex = out[i].vertices[k];
+			
+			if (corner == FaceTable::NO_CORNER) {
+				vertex = {0, 0, 0.0f, 0.0f};
+			} else {
+				vertex.points_index = vertexToPoint ? vertexToPoint[corner] : corner;
+				vertex.normals_index = firstNormals[i] + k;
+				vertex.u = uvs[corner].X();
+				vertex.v = uvs[corner].Y();
+			}
+		}
+	}
+}
+
+#if defined(KERNELS_X86)
+// Two faces per iteration, one in each 128-bit lane
+TARGET_AVX2 void gather_face_vertices_avx2(FaceRecordMLOD* out, const uint32_t* corners, const uint32_t* firstNormals,
+	const uint32_t* vertexToPoint, const Vector2* uvs, size_t count) {
+	const auto uv = reinterpret_cast<const long long*>(uvs);
+	const __m256i lane_order = _mm256_setr_epi32(0, 1, 4, 5, 2, 3, 6, 7);
+	const __m256i corner_offsets = _mm256_setr_epi32(0, 1, 2, 3, 0, 1, 2, 3);
+	size_t i = 0u;
+	
+	for (; i + 2u <= count; i += 2u) {
+		const __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(corners + 4u * i));
+		const __m256i valid = _mm256_xor_si256(_mm256_cmpeq_epi32(c, _mm256_set1_epi32(-1)), _mm256_set1_epi32(-1));
+		
+		const __m256i points = vertexToPoint
+			? _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), reinterpret_cast<const int*>(vertexToPoint), c, valid, 4)
+			: _mm256_and_si256(c, valid);
+		const __m256i first = _mm256_set_m128i(_mm_set1_epi32(firstNormals[i + 1u]), _mm_set1_epi32(firstNormals[i]));
+		const __m256i normals = _mm256_and_si256(_mm256_add_epi32(first, corner_offsets), valid);
+		
+		// uv pairs are 64-bit, corners 0 1 4 5 go in one gather and 2 3 6 7 in the other
+		const __m256i c_ordered = _mm256_permutevar8x32_epi32(c, lane_order);
+		const __m256i valid_ordered = _mm256_permutevar8x32_epi32(valid, lane_order);
+		const __m256i uv_lo = _mm256_mask_i32gather_epi64(_mm256_setzero_si256(), uv, _mm256_castsi256_si128(c_ordered),
+			_mm256_cvtepi32_epi64(_mm256_castsi256_si128(valid_ordered)), 8);
+		const __m256i uv_hi = _mm256_mask_i32gather_epi64(_mm256_setzero_si256(), uv, _mm256_extracti128_si256(c_ordered, 1),
+			_mm256_cvtepi32_epi64(_mm256_extracti128_si256(valid_ordered, 1)), 8);
+		
+		const __m256i pn_lo = _mm256_unpacklo_epi32(points, normals);
+		const __m256i pn_hi = _mm256_unpackhi_epi32(points, normals);
+		const __m256i v0 = _mm256_unpacklo_epi64(pn_lo, uv_lo);
+		const __m256i v1 = _mm256_unpackhi_epi64(pn_lo, uv_lo);
+		const __m256i v2 = _mm256_unpacklo_epi64(pn_hi, uv_hi);
+		const __m256i v3 = _mm256_unpackhi_epi64(pn_hi, uv_hi);
+		
+		const auto face0 = reinterpret_cast<__m256i*>(out[i].vertices.data());
+		const auto face1 = reinterpret_cast<__m256i*>(out[i + 1u].vertices.data());
+		_mm256_storeu_si256(face0 + 0, _mm256_permute2x128_si256(v0, v1, 0x20));
+		_mm256_storeu_si256(face0 + 1, _mm256_permute2x128_si256(v2, v3, 0x20));
+		_mm256_storeu_si256(face1 + 0, _mm256_permute2x128_si256(v0, v1, 0x31));
+		_mm256_storeu_si256(face1 + 1, _mm256_permute2x128_si256(v2, v3, 0x31));
+	}
+	
+	gather_face_vertices_scalar(out + i, corners + 4u * i, firstNormals + i, vertexToPoint, uvs, count - i);
+}
+#endif
+
+// Picks the fastest kernel variants for this CPU, ODOL2MLOD_KERNELS=scalar|sse2|avx2|avx512 caps the choice
+void SelectKernels() {
+	std::string cap = "avx512";
+	if (const char* env = std::getenv("ODOL2MLOD_KERNELS")) {
+		cap = env;
+	}
+	
+	kernels = {"scalar", lzss_decode_block<false>, checksum_scalar, {translate_points_scalar<false>, translate_points_scalar<true>},
+		gather_face_vertices_scalar, count_out_of_range_scalar<uint16_t>, count_out_of_range_scalar<uint32_t>,
+		count_non_finite_scalar};
+	
+#if defined(KERNELS_X86)
+	__builtin_cpu_init();
+	
+	if (cap == "scalar")
+		return;
+	
+	if (__builtin_cpu_supports("sse2"))
+		kernels = {"sse2", lzss_decode_block<true>, checksum_sse2, {translate_points_sse2<false>, translate_points_sse2<true>},
+			gather_face_vertices_scalar, count_out_of_range_u16_sse2, count_out_of_range_u32_sse2, count_non_finite_sse2};
+	
+	if (cap == "sse2")
+		return;
+	
+	// LZSS decoding is a serial byte stream, the wider variants share its 16 byte match copy,
+	// face gathers have no SSE2 form and gain nothing from AVX-512 lanes over AVX2
+	if (__builtin_cpu_supports("avx2"))
+		kernels = {"avx2", lzss_decode_block<true>, checksum_avx2, {translate_points_avx2<false>, translate_points_avx2<true>},
+			gather_face_vertices_avx2, count_out_of_range_u16_avx2, count_out_of_range_u32_avx2, count_non_finite_avx2};
+	
+	if (cap == "avx2")
+		return;
+	
+	if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+		kernels = {"avx512", lzss_decode_block<true>, checksum_avx512, {translate_points_avx512<false>, translate_points_avx512<true>},
+			gather_face_vertices_avx2, count_out_of_range_u16_avx512, count_out_of_range_u32_avx512, count_non_finite_avx512};
+#endif
+}
+
+template <FACE_LAYOUT layout>
+inline bool IsQuadMLOD(const Face& face) noexcept {
+	if constexpr (layout == FACE_LAYOUT_QUADS) {
+		return true;
+	} else if constexpr (layout == FACE_LAYOUT_TRIANGLES) {
+		return false;
+	} else {
+		return face.IsQuad();
+	}
+}
+
+uint32_t convert_face_flags(uint32_t flags_odol) {
+	uint32_t flags_mlod = 0u;
+	
+	if ((flags_odol & 0x40) != 0u) flags_mlod|=0x8;	//?
+	if ((flags_odol & 0x20) != 0u) flags_mlod|=0x10; //shadow off
+
+	if ((flags_odol & 0x4000000) != 0u) flags_mlod|=0x100;//zbias low
+	if ((flags_odol & 0x8000000) != 0u) flags_mlod|=0x200;//zbias middle
+	if ((flags_odol & 0xC000000) != 0u) flags_mlod|=0x300;//zbias high
+	if ((flags_odol & 0x20000000) != 0u) flags_mlod|=0x1000000;//texture merging off
+	
+	return flags_mlod;
+}
+
+// Reverse of convert_face_flags, any z bias comes out of it as high so low and middle only come from MLOD editors
+uint32_t convert_face_flags_to_odol(uint32_t flags_mlod) {
+	uint32_t flags_odol = 0u;
+	
+	if ((flags_mlod & 0x8) != 0u) flags_odol|=0x40;
+	if ((flags_mlod & 0x10) != 0u) flags_odol|=0x20; //shadow off
+	
+	if ((flags_mlod & 0x300) == 0x100) flags_odol|=0x4000000; //zbias low
+	if ((flags_mlod & 0x300) == 0x200) flags_odol|=0x8000000; //zbias middle
+	if ((flags_mlod & 0x300) == 0x300) flags_odol|=0xC000000; //zbias high
+	if ((flags_mlod & 0x1000000) != 0u) flags_odol|=0x20000000; //texture merging off
+	
+	return flags_odol;
+}
+
+// Unique normals of a LOD and the index of each face corner's normal in them
+struct NormalTable {
+	std::vector<Vector3F> normals;
+	std::vector<uint32_t> remap;
+};
+
+// Merges the face corner normals that are equal after quantizing to 1/16384, keeping the first one seen
+NormalTable DeduplicateNormals(const LodShape& lod, uint32_t normalCount) {
+	struct Key {
+		int32_t x, y, z;
+		bool operator==(const Key& other) const noexcept { return x == other.x && y == other.y && z == other.z; }
+	};
+	struct KeyHash {
+		size_t operator()(const Key& key) const noexcept {
+			uint64_t h = static_cast<uint32_t>(key.x) * 0x9E3779B97F4A7C15ull;
+			h = (h ^ static_cast<uint32_t>(key.y)) * 0xC2B2AE3D27D4EB4Full;
+			h = (h ^ static_cast<uint32_t>(key.z)) * 0x165667B19E3779F9ull;
+			return static_cast<size_t>(h ^ (h >> 32));
+		}
+	};
+	const auto quantize = [](float value) {
+		return std::isfinite(value) ? static_cast<int32_t>(std::lround(std::clamp(value, -65536.0f, 65536.0f) * 16384.0f)) : 0;
+	};
+
+	NormalTable table;
+	table.remap.resize(normalCount);
+	std::unordered_map<Key, uint32_t, KeyHash> unique;
+	unique.reserve(lod.GetNormals().size());
+
+	const auto& faces = lod.GetOriginalFaces();
+	const auto& faceTable = lod.GetFaceTable();
+	for (size_t i = 0u; i < faces.size(); ++i) {
+		const auto& face = faces[i];
+		for (size_t k = 0u; k < (face.IsQuad() ? 4u : 3u); ++k) {
+			const auto& normal = lod.GetNormals()[faceTable.corners[4u * i + k]];
+			const Key key = {quantize(normal.X()), quantize(normal.Y()), quantize(normal.Z())};
+			const auto [it, inserted] = unique.try_emplace(key, static_cast<uint32_t>(table.normals.size()));
+			if (inserted) {
+				table.normals.push_back(normal);
+			}
+			table.remap[faceTable.firstNormals[i] + k] = it->second;
+		}
+	}
+
+	return table;
+}
+
+// Points, normals and faces of one LOD, specialized on everything that is constant for the LOD.
+// All records are fixed size, so each section is split into chunks written in parallel at known offsets.
+template <bool merge, bool only_user_value, FACE_LAYOUT layout>
+void WriteLodGeometryMLOD(fp::file& out, const Shape& shape, const LodShape& lod, uint32_t normalCount,
+	const NormalTable* normalTable) {
+	constexpr size_t minChunk = 4096u;
+	const auto& positions = lod.GetPositions();
+	const auto& flags = lod.GetFlags();
+	const auto& normals = lod.GetNormals();
+	const auto& uvs = lod.GetUvs();
+	const auto& faces = lod.GetOriginalFaces();
+	const auto& table = lod.GetFaceTable();
+	const auto center = shape.GetLodCenter();
+
+	// Points
+	{
+		std::vector<PointMLOD> points;
+		if constexpr (merge) {
+			const auto& pointToVertices = lod.GetPointToVertices();
+			points.resize(pointToVertices.size());
+			ParallelFor(points.size(), minChunk, [&](size_t begin, size_t end) {
+				kernels.translate_points[only_user_value](points.data() + begin, positions.data(), flags.data(),
+					pointToVertices.data() + begin, end - begin, center);
+			});
+		} else {
+			points.resize(std::min(positions.size(), flags.size()));
+			ParallelFor(points.size(), minChunk, [&](size_t begin, size_t end) {
+				kernels.translate_points[only_user_value](points.data() + begin, positions.data() + begin,
+					flags.data() + begin, nullptr, end - begin, center);
+			});
+		}
+		out.write(points);
+	}
+
+	// Normals, one per face corner in the corner order of the face records
+	if (normalTable) {
+		out.write(normalTable->normals);
+	} else {
+		std::vector<Vector3F> faceNormals(normalCount);
+		ParallelFor(faces.size(), minChunk, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i) {
+				const size_t normalIndex = table.firstNormals[i];
+				const uint32_t* corners = table.corners.data() + 4u * i;
+				faceNormals[normalIndex + 0u] = normals[corners[0]];
+				faceNormals[normalIndex + 1u] = normals[corners[1]];
+				faceNormals[normalIndex + 2u] = normals[corners[2]];
+				if (IsQuadMLOD<layout>(faces[i])) {
+					faceNormals[normalIndex + 3u] = normals[corners[3]];
+				}
+			}
+		});
+		out.write(faceNormals);
+	}
+
+	// Faces
+	{
+		// Padded texture names, the last one stands for an index out of range
+		std::vector<std::array<char, 32u>> textures(lod.GetTextureNames().size() + 1u);
+		for (auto [texture, name] : fp::zip(textures, lod.GetTextureNames())) {
+			texture.fill('\0');
+			fp::span_copy(name, texture);
+			texture.back() = '\0';
+		}
+		textures.back().fill('\0');
+
+		std::vector<uint32_t> vertexToPoint;
+		if constexpr (merge) {
+			vertexToPoint.assign(lod.GetVertexToPoints().begin(), lod.GetVertexToPoints().end());
+		}
+
+		std::vector<FaceRecordMLOD> records(faces.size());
+		ParallelFor(records.size(), minChunk, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i) {
+				const auto& face = faces[i];
+				auto& record = records[i];
+				record.texture = textures[std::min<size_t>(face.textureIndex, textures.size() - 1u)];
+				record.type = IsQuadMLOD<layout>(face) ? 4u : 3u;
+				record.flags = convert_face_flags(face.flags);
+			}
+
+			kernels.gather_face_vertices(records.data() + begin, table.corners.data() + 4u * begin,
+				table.firstNormals.data() + begin, merge ? vertexToPoint.data() : nullptr, uvs.data(), end - begin);
+
+			if (normalTable) {
+				for (size_t i = begin; i < end; ++i) {
+					for (size_t k = 0u; k < records[i].type; ++k) {
+						auto& vertex = records[i].vertices[k];
+						vertex.normals_index = normalTable->remap[vertex.normals_index];
+					}
+				}
+			}
+		});
+		out.write(records);
+	}
+}
+
+using LodGeometryWriter = void (*)(fp::file&, const Shape&, const LodShape&, uint32_t, const NormalTable*);
+
+template <bool merge, bool only_user_value>
+LodGeometryWriter SelectLodGeometryWriter(FACE_LAYOUT layout) {
+	switch (layout) {
+		case FACE_LAYOUT_TRIANGLES : return WriteLodGeometryMLOD<merge, only_user_value, FACE_LAYOUT_TRIANGLES>;
+		case FACE_LAYOUT_QUADS     : return WriteLodGeometryMLOD<merge, only_user_value, FACE_LAYOUT_QUADS>;
+		default                    : return WriteLodGeometryMLOD<merge, only_user_value, FACE_LAYOUT_MIXED>;
+	}
+}
+
+LodGeometryWriter SelectLodGeometryWriter(bool merge, bool only_user_value, FACE_LAYOUT layout) {
+	if (merge) {
+		return only_user_value ? SelectLodGeometryWriter<true, true>(layout) : SelectLodGeometryWriter<true, false>(layout);
+	} else {
+		return only_user_value ? SelectLodGeometryWriter<false, true>(layout) : SelectLodGeometryWriter<false, false>(layout);
+	}
+}
+
+void WriteHeaderMLOD(fp::file& out, uint32_t lodCount) {
+	// P3DHeader
+	constexpr static uint32_t mlodVersion = 0x0101;
+	out.write(fp::to_bytes(signature_mlod));
+	out.write(fp::to_bytes(mlodVersion));
+	out.write(fp::to_bytes(lodCount));
+}
+
+// Copy of a LOD whose point tables join the vertices closer than epsilon that have the same flags and
+// belong to the same selections with the same weights. Vertices go into a uniform grid of epsilon sized
+// cells, and each one is compared only with the points already in the 27 cells around it.
+LodShape WeldPoints(const LodShape& source, float epsilon) {
+	const auto& positions = source.GetPositions();
+	const auto& flags = source.GetFlags();
+	const size_t vertexCount = std::min(positions.size(), flags.size());
+
+	// Hash of the selections each vertex belongs to
+	std::vector<uint64_t> selections(vertexCount, 0u);
+	for (size_t i = 0u; i < source.GetNamedSections().size(); ++i) {
+		const auto& sec = source.GetNamedSections()[i];
+		for (size_t j = 0u; j < sec.vertexIndices.size(); ++j) {
+			const auto index = sec.vertexIndices[j];
+			if (index < vertexCount) {
+				const uint64_t weight = j < sec.vertexWeights.size() ? sec.vertexWeights[j] : 0x100u;
+				selections[index] = (selections[index] ^ ((i + 1u) << 9 | weight)) * 0x9E3779B97F4A7C15ull;
+			}
+		}
+	}
+
+	struct Cell {
+		int64_t x, y, z;
+		bool operator==(const Cell& other) const noexcept { return x == other.x && y == other.y && z == other.z; }
+	};
+	struct CellHash {
+		size_t operator()(const Cell& cell) const noexcept {
+			uint64_t h = static_cast<uint64_t>(cell.x) * 0x9E3779B97F4A7C15ull;
+			h = (h ^ static_cast<uint64_t>(cell.y)) * 0xC2B2AE3D27D4EB4Full;
+			h = (h ^ static_cast<uint64_t>(cell.z)) * 0x165667B19E3779F9ull;
+			return static_cast<size_t>(h ^ (h >> 32));
+		}
+	};
+	const auto cellOf = [epsilon](const Vector3F& position) {
+		return Cell{static_cast<int64_t>(std::floor(position.X() / epsilon)),
+			static_cast<int64_t>(std::floor(position.Y() / epsilon)),
+			static_cast<int64_t>(std::floor(position.Z() / epsilon))};
+	};
+
+	LodShape welded = source;
+	welded.m_pointToVertices.clear();
+	welded.m_vertexToPoints.assign(positions.size(), 0u);
+
+	// Points of a cell are linked through next, starting from the cell's entry in heads
+	std::unordered_map<Cell, uint32_t, CellHash> heads;
+	heads.reserve(vertexCount);
+	std::vector<uint32_t> next;
+	next.reserve(vertexCount);
+	constexpr uint32_t none = 0xFFFFFFFFu;
+	const float epsilon2 = epsilon * epsilon;
+
+	for (size_t vertex = 0u; vertex < vertexCount; ++vertex) {
+		const auto& position = positions[vertex];
+		const Cell cell = cellOf(position);
+		uint32_t found = none;
+
+		for (int64_t dx = -1; dx <= 1 && found == none; ++dx) {
+			for (int64_t dy = -1; dy <= 1 && found == none; ++dy) {
+				for (int64_t dz = -1; dz <= 1 && found == none; ++dz) {
+					const auto head = heads.find(Cell{cell.x + dx, cell.y + dy, cell.z + dz});
+					for (uint32_t point = head == heads.end() ? none : head->second; point != none; point = next[point]) {
+						const auto other = welded.m_pointToVertices[point];
+						const Vector3F d = positions[other] - position;
+						if (d.X() * d.X() + d.Y() * d.Y() + d.Z() * d.Z() <= epsilon2 && flags[other] == flags[vertex]
+							&& selections[other] == selections[vertex]) {
+							found = point;
+							break;
+						}
+					}
+				}
+			}
+		}
+
+		if (found == none) {
+			found = static_cast<uint32_t>(welded.m_pointToVertices.size());
+			welded.m_pointToVertices.push_back(static_cast<uint16_t>(vertex));
+			const auto [head, inserted] = heads.try_emplace(cell, found);
+			next.push_back(inserted ? none : head->second);
+			head->second = found;
+		}
+		welded.m_vertexToPoints[vertex] = static_cast<uint16_t>(found);
+	}
+
+	return welded;
+}
+
+// Marks a vertex that no point of a remapped LOD uses
+constexpr uint16_t NO_POINT = 0xFFFFu;
+
+// Copy of a LOD whose point tables keep only the points that a face or a named section uses, or that
+// carry mass. merged tells whether the points are the ones of the LOD's point tables or its vertices,
+// vertexMasses is empty or has the mass of every vertex.
+LodShape CompactPoints(const LodShape& source, bool merged, const std::vector<float>& vertexMasses) {
+	const size_t vertexCount = source.GetPositions().size();
+	const size_t pointCount = merged ? source.m_pointToVertices.size() : vertexCount;
+	const auto point = [&](uint16_t vertex) -> size_t {
+		return merged ? source.m_vertexToPoints[vertex] : vertex;
+	};
+
+	std::vector<uint8_t> live(pointCount, 0u);
+	for (const auto& face : source.GetOriginalFaces()) {
+		live[point(face.v0)] = live[point(face.v1)] = live[point(face.v2)] = live[point(face.v3)] = 1u;
+	}
+	for (const auto& sec : source.GetNamedSections()) {
+		for (auto index : sec.vertexIndices) {
+			live[point(index)] = 1u;
+		}
+	}
+	for (size_t vertex = 0u; vertex < vertexMasses.size(); ++vertex) {
+		if (vertexMasses[vertex] != 0.0f) {
+			live[point(static_cast<uint16_t>(vertex))] = 1u;
+		}
+	}
+
+	std::vector<uint16_t> dense(pointCount, NO_POINT);
+	LodShape compacted = source;
+	compacted.m_pointToVertices.clear();
+	for (size_t i = 0u; i < pointCount; ++i) {
+		if (live[i]) {
+			dense[i] = static_cast<uint16_t>(compacted.m_pointToVertices.size());
+			compacted.m_pointToVertices.push_back(merged ? source.m_pointToVertices[i] : static_cast<uint16_t>(i));
+		}
+	}
+
+	compacted.m_vertexToPoints.resize(vertexCount);
+	for (size_t vertex = 0u; vertex < vertexCount; ++vertex) {
+		const auto old = merged ? source.m_vertexToPoints[vertex] : vertex;
+		compacted.m_vertexToPoints[vertex] = old == NO_POINT ? NO_POINT : dense[old];
+	}
+
+	return compacted;
+}
+
+// Reduces the per vertex animation phases of a remapped LOD to the vertex each point stands for
+void RemapAnimationPhases(LodShape& lod) {
+	for (auto& phase : lod.m_animationPhases) {
+		if (phase.points.size() != lod.GetPositions().size()) {
+			continue;
+		}
+		std::vector<Vector3F> points;
+		points.reserve(lod.m_pointToVertices.size());
+		for (auto vertex : lod.m_pointToVertices) {
+			points.push_back(phase.points[vertex]);
+		}
+		phase.points = std::move(points);
+	}
+}
+
+// Puts the faces of a LOD in the given order, named selections follow the faces. Selections hold 16 bit face
+// indices, so the LOD is left as it was when one of their faces would move past face 65535.
+bool ReorderFaces(LodShape& lod, const std::vector<uint32_t>& order) {
+	auto& faces = lod.m_orignalFaces;
+	std::vector<uint32_t> position(faces.size());
+	for (size_t i = 0u; i < order.size(); ++i) {
+		position[order[i]] = static_cast<uint32_t>(i);
+	}
+	for (const auto& sec : lod.m_namedSections) {
+		for (const auto faceIndex : sec.faceIndices) {
+			if (faceIndex < position.size() && position[faceIndex] > 0xFFFFu) {
+				return false;
+			}
+		}
+	}
+
+	std::vector<Face> sorted;
+	sorted.reserve(faces.size());
+	for (const auto index : order) {
+		sorted.push_back(faces[index]);
+	}
+	faces = std::move(sorted);
+
+	for (auto& sec : lod.m_namedSections) {
+		for (auto& faceIndex : sec.faceIndices) {
+			if (faceIndex < position.size()) {
+				faceIndex = static_cast<uint16_t>(position[faceIndex]);
+			}
+		}
+	}
+
+	lod.BuildFaceTable();
+	return true;
+}
+
+// Puts faces with the same texture next to each other, ordered by flags within a texture and otherwise
+// keeping their order. Counting sort over the texture index.
+bool SortFacesByTexture(LodShape& lod) {
+	auto& faces = lod.m_orignalFaces;
+	uint32_t textureCount = 0u;
+	for (const auto& face : faces) {
+		textureCount = std::max(textureCount, face.textureIndex + 1u);
+	}
+
+	std::vector<size_t> starts(textureCount + 1u, 0u);
+	for (const auto& face : faces) {
+		++starts[face.textureIndex + 1u];
+	}
+	for (size_t i = 1u; i < starts.size(); ++i) {
+		starts[i] += starts[i - 1u];
+	}
+
+	std::vector<uint32_t> order(faces.size());
+	{
+		auto next = starts;
+		for (size_t i = 0u; i < faces.size(); ++i) {
+			order[next[faces[i].textureIndex]++] = static_cast<uint32_t>(i);
+		}
+	}
+	for (size_t texture = 0u; texture < textureCount; ++texture) {
+		std::stable_sort(order.begin() + starts[texture], order.begin() + starts[texture + 1u], [&](uint32_t a, uint32_t b) {
+			return faces[a].flags < faces[b].flags;
+		});
+	}
+
+	return ReorderFaces(lod, order);
+}
+
+// Per vertex state of OptimizeVertexCache, sized for the LOD once and cleared again after each group
+struct VertexCacheScratch {
+	std::vector<uint32_t> first;     // start of the vertex's faces in faces
+	std::vector<uint32_t> remaining; // faces not yet emitted around the vertex
+	std::vector<int8_t> position;    // position in the cache or -1
+	std::vector<uint32_t> faces;
+};
+
+// Forsyth's linear-speed vertex cache optimization of the faces [begin, end), quads count as one face of
+// four vertices. Greedily emits the face whose vertices score best for an LRU cache of the last vertices
+// used and for the fewest faces left on them; only faces around the cached vertices are rescored.
+void OptimizeVertexCache(const std::vector<Face>& faces, size_t begin, size_t end, std::vector<uint32_t>& order,
+	VertexCacheScratch& scratch) {
+	constexpr int cacheSize = 32;
+	constexpr uint32_t none = 0xFFFFFFFFu;
+	const size_t count = end - begin;
+	const auto cornerCount = [&](size_t face) { return faces[begin + face].IsQuad() ? 4u : 3u; };
+	const auto corner = [&](size_t face, size_t k) -> uint16_t {
+		const auto& f = faces[begin + face];
+		return k == 0u ? f.v0 : k == 1u ? f.v1 : k == 2u ? f.v2 : f.v3;
+	};
+
+	// Faces around each vertex of the group
+	std::vector<uint16_t> vertices;
+	for (size_t face = 0u; face < count; ++face) {
+		for (size_t k = 0u; k < cornerCount(face); ++k) {
+			if (scratch.remaining[corner(face, k)]++ == 0u) {
+				vertices.push_back(corner(face, k));
+			}
+		}
+	}
+	uint32_t offset = 0u;
+	for (auto vertex : vertices) {
+		scratch.first[vertex] = offset;
+		offset += scratch.remaining[vertex];
+		scratch.remaining[vertex] = 0u;
+	}
+	scratch.faces.resize(std::max<size_t>(scratch.faces.size(), offset));
+	for (size_t face = 0u; face < count; ++face) {
+		for (size_t k = 0u; k < cornerCount(face); ++k) {
+			const auto vertex = corner(face, k);
+			scratch.faces[scratch.first[vertex] + scratch.remaining[vertex]++] = static_cast<uint32_t>(face);
+		}
+	}
+
+	const auto vertexScore = [&](uint16_t vertex) {
+		const uint32_t left = scratch.remaining[vertex];
+		const int position = scratch.position[vertex];
+		float score = 0.0f;
+		if (position >= 0) {
+			score = position < 3 ? 0.75f : std::pow(1.0f - static_cast<float>(position - 3) / (cacheSize - 3), 1.5f);
+		}
+		return left == 0u ? score : score + 2.0f / std::sqrt(static_cast<float>(left));
+	};
+	const auto faceScore = [&](size_t face) {
+		float score = 0.0f;
+		for (size_t k = 0u; k < cornerCount(face); ++k) {
+			score += vertexScore(corner(face, k));
+		}
+		return score;
+	};
+
+	std::vector<uint8_t> emitted(count, 0u);
+
+	std::vector<uint16_t> cache;
+	std::vector<uint16_t> nextCache;
+	size_t scan = 0u;
+	uint32_t best = none;
+
+	for (size_t done = 0u; done < count; ++done) {
+		if (best == none) {
+			// Nothing left around the cache, go on from the first face not emitted yet; the cursor only moves
+			// forward so restarts stay linear over the whole group
+			while (emitted[scan]) {
+				++scan;
+			}
+			best = static_cast<uint32_t>(scan);
+		}
+
+		order.push_back(static_cast<uint32_t>(begin + best));
+		emitted[best] = 1u;
+
+		nextCache.clear();
+		for (size_t k = 0u; k < cornerCount(best); ++k) {
+			const auto vertex = corner(best, k);
+			if (std::find(nextCache.begin(), nextCache.end(), vertex) == nextCache.end()) {
+				nextCache.push_back(vertex);
+			}
+			// Drop the emitted face from the vertex's remaining faces
+			const auto first = scratch.faces.begin() + scratch.first[vertex];
+			auto& left = scratch.remaining[vertex];
+			const auto it = std::find(first, first + left, best);
+			if (it != first + left) {
+				std::iter_swap(it, first + left - 1);
+				--left;
+			}
+		}
+		for (auto vertex : cache) {
+			if (std::find(nextCache.begin(), nextCache.end(), vertex) == nextCache.end()) {
+				nextCache.push_back(vertex);
+			}
+		}
+
+		// Vertices pushed out of the cache lose their cache score
+		for (size_t i = cacheSize; i < nextCache.size(); ++i) {
+			scratch.position[nextCache[i]] = -1;
+		}
+		nextCache.resize(std::min<size_t>(nextCache.size(), cacheSize));
+		for (size_t i = 0u; i < nextCache.size(); ++i) {
+			scratch.position[nextCache[i]] = static_cast<int8_t>(i);
+		}
+		std::swap(cache, nextCache);
+
+		// Rescore the faces around the cache and pick the best of them
+		best = none;
+		float bestScore = -1.0f;
+		for (auto vertex : cache) {
+			const auto first = scratch.faces.begin() + scratch.first[vertex];
+			for (auto it = first; it != first + scratch.remaining[vertex]; ++it) {
+				const float score = faceScore(*it);
+				if (score > bestScore) {
+					bestScore = score;
+					best = *it;
+				}
+			}
+		}
+	}
+
+	for (auto vertex : cache) {
+		scratch.position[vertex] = -1;
+	}
+}
+
+// Vertex cache order inside every run of faces with the same texture and flags, after grouping them
+bool OptimizeFaceOrder(LodShape& lod) {
+	if (!SortFacesByTexture(lod)) {
+		return false;
+	}
+
+	const auto& faces = lod.m_orignalFaces;
+	std::vector<uint32_t> order;
+	order.reserve(faces.size());
+	VertexCacheScratch scratch;
+	scratch.first.resize(lod.GetPositions().size());
+	scratch.remaining.assign(lod.GetPositions().size(), 0u);
+	scratch.position.assign(lod.GetPositions().size(), -1);
+
+	for (size_t begin = 0u, end = 0u; begin < faces.size(); begin = end) {
+		end = begin + 1u;
+		while (end < faces.size() && faces[end].textureIndex == faces[begin].textureIndex && faces[end].flags == faces[begin].flags) {
+			++end;
+		}
+		OptimizeVertexCache(faces, begin, end, order, scratch);
+	}
+
+	return ReorderFaces(lod, order);
+}
+
+// Point pairs of the edges whose faces have different vertex normals on either end, in one pass over
+// the faces: each edge is keyed by its two points and compared with the first face that had it
+std::vector<uint32_t> FindSharpEdges(const LodShape& lod, bool merged) {
+	constexpr float smoothCos = 0.9998f; // about one degree
+	const auto& normals = lod.GetNormals();
+	const bool hasPoints = !lod.m_vertexToPoints.empty();
+	const auto point = [&](uint16_t vertex) -> uint32_t {
+		return hasPoints ? lod.VertexToPoint(vertex) : vertex;
+	};
+	const auto output = [&](uint16_t vertex) -> uint32_t {
+		return merged ? lod.VertexToPoint(vertex) : vertex;
+	};
+	const auto key = [](uint32_t a, uint32_t b) {
+		return static_cast<uint64_t>(std::min(a, b)) << 32 | std::max(a, b);
+	};
+	const auto smooth = [&](uint16_t a, uint16_t b) {
+		const auto& na = normals[a];
+		const auto& nb = normals[b];
+		const float dot = na.X() * nb.X() + na.Y() * nb.Y() + na.Z() * nb.Z();
+		const float lengths = std::sqrt((na.X() * na.X() + na.Y() * na.Y() + na.Z() * na.Z())
+			* (nb.X() * nb.X() + nb.Y() * nb.Y() + nb.Z() * nb.Z()));
+		return dot >= smoothCos * lengths;
+	};
+
+	struct Edge {
+		uint16_t v0, v1;
+	};
+	std::unordered_map<uint64_t, Edge> edges;
+	edges.reserve(2u * lod.GetOriginalFaces().size());
+	std::unordered_set<uint64_t> sharp;
+	std::vector<uint32_t> pairs;
+
+	const auto add = [&](uint16_t a, uint16_t b) {
+		const uint64_t pair = key(output(a), output(b));
+		if (sharp.insert(pair).second) {
+			pairs.push_back(output(a));
+			pairs.push_back(output(b));
+		}
+	};
+
+	for (const auto& face : lod.GetOriginalFaces()) {
+		const uint16_t vertices[4] = {face.v0, face.v1, face.v2, face.v3};
+		const size_t n = face.IsQuad() ? 4u : 3u;
+		for (size_t k = 0u; k < n; ++k) {
+			const uint16_t a = vertices[k];
+			const uint16_t b = vertices[(k + 1u) % n];
+			const auto [it, inserted] = edges.try_emplace(key(point(a), point(b)), Edge{a, b});
+			if (inserted) {
+				continue;
+			}
+
+			// Match the ends by point, the other face runs along the edge the other way
+			const Edge& first = it->second;
+			const bool same = point(first.v0) == point(a);
+			const uint16_t firstA = same ? first.v0 : first.v1;
+			const uint16_t firstB = same ? first.v1 : first.v0;
+			if (!smooth(firstA, a) || !smooth(firstB, b)) {
+				add(firstA, firstB);
+				add(a, b);
+			}
+		}
+	}
+
+	return pairs;
+}
+
+// Vertices sharing the exact same position
+struct PositionGroups {
+	std::vector<uint32_t> group;                // group of each vertex
+	std::vector<std::vector<uint32_t>> members; // vertices of each group, in vertex order
+};
+
+PositionGroups GroupPositions(const std::vector<Vector3F>& positions) {
+	constexpr uint32_t none = 0xFFFFFFFFu;
+	PositionGroups groups;
+	groups.group.resize(positions.size());
+	std::unordered_map<uint64_t, std::vector<uint32_t>> byBits;
+	byBits.reserve(positions.size());
+
+	for (size_t v = 0u; v < positions.size(); ++v) {
+		uint32_t bits[3];
+		std::memcpy(bits, &positions[v], sizeof(bits));
+		const uint64_t hash = (bits[0] * 0x9E3779B97F4A7C15ull ^ bits[1]) * 0xC2B2AE3D27D4EB4Full ^ bits[2];
+		auto& candidates = byBits[hash];
+		uint32_t found = none;
+		for (auto g : candidates) {
+			if (std::memcmp(&positions[groups.members[g][0]], &positions[v], sizeof(bits)) == 0) {
+				found = g;
+				break;
+			}
+		}
+		if (found == none) {
+			found = static_cast<uint32_t>(groups.members.size());
+			groups.members.emplace_back();
+			candidates.push_back(found);
+		}
+		groups.group[v] = found;
+		groups.members[found].push_back(static_cast<uint32_t>(v));
+	}
+
+	return groups;
+}
+
+// Convex hull of a point set as triangles of indices into it, facing out with (p1 - p0) x (p2 - p0).
+// Quickhull: every face keeps the points above it and the hull grows towards the farthest of them,
+// replacing the faces that point sees by a fan from their horizon. Empty when the points are flat.
+std::vector<std::array<uint32_t, 3>> QuickHull(const std::vector<Vector3F>& points, float epsilon) {
+	struct HullFace {
+		std::array<uint32_t, 3> v;
+		Vector3F normal;
+		float offset;
+		std::vector<uint32_t> outside;
+		bool alive;
+	};
+	std::vector<HullFace> faces;
+	std::vector<uint32_t> pending;                // faces that got outside points
+	std::unordered_map<uint64_t, uint32_t> edges; // directed edge to the face it belongs to
+	const auto edgeKey = [](uint32_t a, uint32_t b) { return static_cast<uint64_t>(a) << 32 | b; };
+	const auto distance = [&](const HullFace& face, uint32_t p) { return face.normal.Dot(points[p]) - face.offset; };
+
+	const auto addFace = [&](uint32_t a, uint32_t b, uint32_t c) {
+		HullFace face = {{a, b, c}, (points[b] - points[a]).Cross(points[c] - points[a]), 0.0f, {}, true};
+		const float length = face.normal.Size();
+		face.normal = length > 0.0f ? face.normal / length : Vector3F();
+		face.offset = face.normal.Dot(points[a]);
+		for (size_t k = 0u; k < 3u; ++k) {
+			edges[edgeKey(face.v[k], face.v[(k + 1u) % 3u])] = static_cast<uint32_t>(faces.size());
+		}
+		faces.push_back(std::move(face));
+		return static_cast<uint32_t>(faces.size() - 1u);
+	};
+	// Gives each point to the first face from firstFace on that it is above, points under all of them are inside
+	const auto assign = [&](const std::vector<uint32_t>& candidates, size_t firstFace, uint32_t skip) {
+		for (auto p : candidates) {
+			for (size_t f = firstFace; f < faces.size() && p != skip; ++f) {
+				if (faces[f].alive && distance(faces[f], p) > epsilon) {
+					if (faces[f].outside.empty()) {
+						pending.push_back(static_cast<uint32_t>(f));
+					}
+					faces[f].outside.push_back(p);
+					break;
+				}
+			}
+		}
+	};
+
+	// Starting tetrahedron from the two farthest axis extremes, the point farthest from their line and the
+	// point farthest from their plane
+	if (points.size() < 4u) {
+		return {};
+	}
+	const auto coordinate = [&](uint32_t p, size_t axis) {
+		return axis == 0u ? points[p].X() : axis == 1u ? points[p].Y() : points[p].Z();
+	};
+	uint32_t extremes[6] = {};
+	for (uint32_t i = 0u; i < points.size(); ++i) {
+		for (size_t axis = 0u; axis < 3u; ++axis) {
+			if (coordinate(i, axis) < coordinate(extremes[2 * axis], axis)) {
+				extremes[2 * axis] = i;
+			}
+			if (coordinate(i, axis) > coordinate(extremes[2 * axis + 1], axis)) {
+				extremes[2 * axis + 1] = i;
+			}
+		}
+	}
+	uint32_t i0 = 0u, i1 = 0u;
+	float best = -1.0f;
+	for (size_t axis = 0u; axis < 3u; ++axis) {
+		const float length = (points[extremes[2 * axis + 1]] - points[extremes[2 * axis]]).Size2();
+		if (length > best) {
+			best = length;
+			i0 = extremes[2 * axis];
+			i1 = extremes[2 * axis + 1];
+		}
+	}
+	uint32_t i2 = 0u;
+	best = -1.0f;
+	for (uint32_t i = 0u; i < points.size(); ++i) {
+		const float area = (points[i1] - points[i0]).Cross(points[i] - points[i0]).Size2();
+		if (area > best) {
+			best = area;
+			i2 = i;
+		}
+	}
+	const Vector3F baseNormal = (points[i1] - points[i0]).Cross(points[i2] - points[i0]);
+	if (baseNormal.Size() <= epsilon * std::sqrt((points[i1] - points[i0]).Size2())) {
+		return {};
+	}
+	uint32_t i3 = 0u;
+	best = -1.0f;
+	for (uint32_t i = 0u; i < points.size(); ++i) {
+		const float height = std::fabs(baseNormal.Dot(points[i] - points[i0]));
+		if (height > best) {
+			best = height;
+			i3 = i;
+		}
+	}
+	if (best <= epsilon * baseNormal.Size()) {
+		return {};
+	}
+
+	if (baseNormal.Dot(points[i3] - points[i0]) > 0.0f) {
+		std::swap(i1, i2);
+	}
+	addFace(i0, i1, i2);
+	addFace(i0, i3, i1);
+	addFace(i1, i3, i2);
+	addFace(i2, i3, i0);
+
+	edges.reserve(6u * points.size());
+	std::vector<uint32_t> all(points.size());
+	std::iota(all.begin(), all.end(), 0u);
+	assign(all, 0u, 0xFFFFFFFFu);
+
+	std::vector<uint32_t> visible, stack, orphans;
+	std::vector<std::pair<uint32_t, uint32_t>> horizon;
+	while (!pending.empty()) {
+		const uint32_t current = pending.back();
+		pending.pop_back();
+		if (!faces[current].alive || faces[current].outside.empty()) {
+			continue;
+		}
+
+		const auto& outside = faces[current].outside;
+		const uint32_t apex = *std::max_element(outside.begin(), outside.end(), [&](uint32_t a, uint32_t b) {
+			return distance(faces[current], a) < distance(faces[current], b);
+		});
+
+		// Faces the apex sees at all, found by walking across edges from the current one. Keeping the ones it
+		// sees by less than epsilon would leave a dent in the hull.
+		visible.assign(1u, current);
+		stack.assign(1u, current);
+		faces[current].alive = false;
+		horizon.clear();
+		while (!stack.empty()) {
+			const uint32_t f = stack.back();
+			stack.pop_back();
+			for (size_t k = 0u; k < 3u; ++k) {
+				const uint32_t a = faces[f].v[k], b = faces[f].v[(k + 1u) % 3u];
+				const uint32_t neighbour = edges[edgeKey(b, a)];
+				if (!faces[neighbour].alive) {
+					continue;
+				}
+				if (distance(faces[neighbour], apex) > 0.0f) {
+					faces[neighbour].alive = false;
+					visible.push_back(neighbour);
+					stack.push_back(neighbour);
+				}
+			}
+		}
+		for (auto f : visible) {
+			for (size_t k = 0u; k < 3u; ++k) {
+				const uint32_t a = faces[f].v[k], b = faces[f].v[(k + 1u) % 3u];
+				if (faces[edges[edgeKey(b, a)]].alive) {
+					horizon.emplace_back(a, b);
+				}
+			}
+		}
+
+		orphans.clear();
+		for (auto f : visible) {
+			orphans.insert(orphans.end(), faces[f].outside.begin(), faces[f].outside.end());
+			faces[f].outside.clear();
+			faces[f].outside.shrink_to_fit();
+		}
+		const size_t firstNew = faces.size();
+		for (auto [a, b] : horizon) {
+			addFace(a, b, apex);
+		}
+		assign(orphans, firstNew, apex);
+	}
+
+	std::vector<std::array<uint32_t, 3>> hull;
+	for (const auto& face : faces) {
+		if (face.alive) {
+			hull.push_back(face.v);
+		}
+	}
+	return hull;
+}
+
+// Faces of a LOD that touch each other, with the hull of their points
+struct ConvexComponent {
+	std::vector<uint32_t> faces;
+	std::vector<uint16_t> vertices;
+	std::vector<std::array<uint16_t, 3>> hull; // vertex indices, in the winding of the component's faces
+	bool closed = true;                        // every edge is shared by exactly two faces
+	bool convex = false;                       // closed and every face lies on the hull
+};
+
+// Splits a LOD into connected components through shared positions and tests each one for convexity
+std::vector<ConvexComponent> FindConvexComponents(const LodShape& lod) {
+	const auto& positions = lod.GetPositions();
+	const auto& faces = lod.GetOriginalFaces();
+	const PositionGroups groups = GroupPositions(positions);
+
+	// Vertices that -d dropped have no point left, selections and hull corners use only the others. Every
+	// group a face reaches has one, the face's own vertex.
+	const auto hasPoint = [&lod](uint32_t v) {
+		return v >= lod.m_vertexToPoints.size() || lod.m_vertexToPoints[v] != NO_POINT;
+	};
+	std::vector<uint32_t> corner(groups.members.size());
+	for (size_t g = 0u; g < groups.members.size(); ++g) {
+		const auto& members = groups.members[g];
+		corner[g] = *std::find_if(members.begin(), members.end() - 1, hasPoint);
+	}
+
+	// Union of the position groups of every face
+	std::vector<uint32_t> parent(groups.members.size());
+	std::iota(parent.begin(), parent.end(), 0u);
+	const auto root = [&](uint32_t g) {
+		while (parent[g] != g) {
+			g = parent[g] = parent[parent[g]];
+		}
+		return g;
+	};
+	for (const auto& face : faces) {
+		const uint32_t r = root(groups.group[face.v0]);
+		for (auto v : {face.v1, face.v2, face.v3}) {
+			parent[root(groups.group[v])] = r;
+		}
+	}
+
+	std::vector<ConvexComponent> components;
+	std::unordered_map<uint32_t, uint32_t> componentOfRoot;
+	for (size_t i = 0u; i < faces.size(); ++i) {
+		const auto [it, inserted] = componentOfRoot.try_emplace(root(groups.group[faces[i].v0]),
+			static_cast<uint32_t>(components.size()));
+		if (inserted) {
+			components.emplace_back();
+		}
+		components[it->second].faces.push_back(static_cast<uint32_t>(i));
+	}
+
+	for (auto& component : components) {
+		// One point per position group, vertices of all of them
+		std::vector<uint32_t> componentGroups;
+		for (auto f : component.faces) {
+			const auto& face = faces[f];
+			for (auto v : {face.v0, face.v1, face.v2, face.v3}) {
+				componentGroups.push_back(groups.group[v]);
+			}
+		}
+		std::sort(componentGroups.begin(), componentGroups.end());
+		componentGroups.erase(std::unique(componentGroups.begin(), componentGroups.end()), componentGroups.end());
+
+		std::vector<Vector3F> points;
+		Vector3F min = positions[groups.members[componentGroups[0]][0]], max = min;
+		for (auto g : componentGroups) {
+			const auto& position = positions[groups.members[g][0]];
+			points.push_back(position);
+			min = Vector3F(std::min(min.X(), position.X()), std::min(min.Y(), position.Y()), std::min(min.Z(), position.Z()));
+			max = Vector3F(std::max(max.X(), position.X()), std::max(max.Y(), position.Y()), std::max(max.Z(), position.Z()));
+			std::copy_if(groups.members[g].begin(), groups.members[g].end(), std::back_inserter(component.vertices), hasPoint);
+		}
+		std::sort(component.vertices.begin(), component.vertices.end());
+
+		const float epsilon = std::max(1e-4f * std::sqrt((max - min).Size2()), 1e-6f);
+		const auto hull = QuickHull(points, epsilon);
+
+		std::unordered_map<uint64_t, uint32_t> edgeFaces;
+		const auto local = [&](uint16_t v) {
+			return static_cast<uint32_t>(std::lower_bound(componentGroups.begin(), componentGroups.end(),
+				groups.group[v]) - componentGroups.begin());
+		};
+
+		// Faces on the hull vote for the winding of the hull triangles
+		int winding = 0;
+		size_t facesOnHull = 0u;
+		for (auto f : component.faces) {
+			const auto& face = faces[f];
+			const uint16_t corners[4] = {face.v0, face.v1, face.v2, face.v3};
+			const size_t count = face.IsQuad() ? 4u : 3u;
+			for (size_t k = 0u; k < count; ++k) {
+				const uint32_t a = local(corners[k]), b = local(corners[(k + 1u) % count]);
+				++edgeFaces[static_cast<uint64_t>(std::min(a, b)) << 32 | std::max(a, b)];
+			}
+
+			for (const auto& triangle : hull) {
+				const Vector3F normal = (points[triangle[1]] - points[triangle[0]]).Cross(points[triangle[2]] - points[triangle[0]]);
+				const float length = normal.Size();
+				if (length <= 0.0f) {
+					continue;
+				}
+				bool onPlane = true;
+				for (size_t k = 0u; k < count && onPlane; ++k) {
+					onPlane = std::fabs(normal.Dot(positions[corners[k]] - points[triangle[0]])) <= epsilon * length;
+				}
+				if (onPlane) {
+					const Vector3F faceNormal = (positions[face.v1] - positions[face.v0]).Cross(positions[face.v2] - positions[face.v0]);
+					winding += faceNormal.Dot(normal) >= 0.0f ? 1 : -1;
+					++facesOnHull;
+					break;
+				}
+			}
+		}
+		for (const auto& [edge, count] : edgeFaces) {
+			component.closed = component.closed && count == 2u;
+		}
+		component.convex = !hull.empty() && component.closed && facesOnHull == component.faces.size();
+
+		// Without a vote follow the corner order that turns ODOL faces into MLOD ones
+		for (const auto& triangle : hull) {
+			const auto vertex = [&](uint32_t k) { return static_cast<uint16_t>(corner[componentGroups[triangle[k]]]); };
+			if (winding > 0) {
+				component.hull.push_back({vertex(0), vertex(1), vertex(2)});
+			} else {
+				component.hull.push_back({vertex(1), vertex(0), vertex(2)});
+			}
+		}
+	}
+
+	return components;
+}
+
+// Replaces the component01... selections of a geometry LOD by one per connected component, and with
+// replaceHulls the faces of every component that is not convex by its hull. Reports what it finds.
+void BuildConvexComponents(LodShape& lod, bool replaceHulls) {
+	const auto components = FindConvexComponents(lod);
+	const auto& faces = lod.GetOriginalFaces();
+
+	size_t hullFaces = 0u;
+	std::vector<uint8_t> replace(components.size(), 0u);
+	for (size_t i = 0u; i < components.size(); ++i) {
+		if (!components[i].convex) {
+			std::cout << "Geometry component" << std::setw(2) << std::setfill('0') << i + 1u << std::setfill(' ')
+				<< (components[i].hull.empty() ? " is flat" : components[i].closed ? " is not convex" : " is not closed");
+			if (replaceHulls && !components[i].hull.empty()) {
+				replace[i] = 1u;
+				hullFaces += components[i].hull.size();
+				std::cout << ", replaced by its hull";
+			}
+			std::cout << std::endl;
+		}
+	}
+	if (faces.size() + hullFaces > 0xFFFFu) {
+		std::cout << "Too many faces for the hulls of the geometry components" << std::endl;
+		std::fill(replace.begin(), replace.end(), 0u);
+	}
+
+	// New index of every face, replaced ones are dropped and their hull follows the kept faces
+	constexpr uint32_t dropped = 0xFFFFFFFFu;
+	std::vector<uint32_t> faceMap(faces.size());
+	for (size_t i = 0u; i < components.size(); ++i) {
+		for (auto f : components[i].faces) {
+			faceMap[f] = replace[i] ? dropped : 0u;
+		}
+	}
+	std::vector<Face> newFaces;
+	newFaces.reserve(faces.size() + hullFaces);
+	for (size_t f = 0u; f < faces.size(); ++f) {
+		if (faceMap[f] != dropped) {
+			faceMap[f] = static_cast<uint32_t>(newFaces.size());
+			newFaces.push_back(faces[f]);
+		}
+	}
+
+	auto& sections = lod.m_namedSections;
+	sections.erase(std::remove_if(sections.begin(), sections.end(), [](const NamedSection& sec) {
+		return sec.name.size() > 9u && sec.name.compare(0u, 9u, "component") == 0
+			&& std::all_of(sec.name.begin() + 9, sec.name.end(), ::isdigit);
+	}), sections.end());
+	for (auto& sec : sections) {
+		const bool weighted = !sec.faceWeights.empty();
+		size_t kept = 0u;
+		for (size_t j = 0u; j < sec.faceIndices.size(); ++j) {
+			const uint32_t index = faceMap[sec.faceIndices[j]];
+			if (index != dropped) {
+				sec.faceIndices[kept] = static_cast<uint16_t>(index);
+				if (weighted) {
+					sec.faceWeights[kept] = sec.faceWeights[j];
+				}
+				++kept;
+			}
+		}
+		if (kept != sec.faceIndices.size()) {
+			sec.faceIndices.resize(kept);
+			sec.faceWeights.resize(weighted ? kept : 0u);
+			sec.faceSelectionIndices.clear();
+			sec.faceSelectionIndices2.clear();
+		}
+	}
+
+	for (size_t i = 0u; i < components.size(); ++i) {
+		const auto& component = components[i];
+		NamedSection sec;
+		std::ostringstream name;
+		name << "component" << std::setw(2) << std::setfill('0') << i + 1u;
+		sec.name = name.str();
+		sec.needSelection = false;
+		sec.vertexIndices = component.vertices;
+
+		if (replace[i]) {
+			const auto& face = faces[component.faces[0]];
+			for (const auto& triangle : component.hull) {
+				sec.faceIndices.push_back(static_cast<uint16_t>(newFaces.size()));
+				newFaces.emplace_back(face.flags, face.textureIndex, 0u, triangle[0], triangle[1], triangle[2]);
+			}
+		} else {
+			for (auto f : component.faces) {
+				sec.faceIndices.push_back(static_cast<uint16_t>(faceMap[f]));
+			}
+		}
+		sections.push_back(std::move(sec));
+	}
+
+	lod.m_orignalFaces = std::move(newFaces);
+	lod.BuildFaceTable();
+}
+
+// Mass of every vertex of a LOD, a point's mass is shared evenly between its vertices
+std::vector<float> VertexMasses(const Shape& shape, const LodShape& lod) {
+	if (shape.GetMasses().size() == lod.GetPositions().size()) {
+		return shape.GetMasses();
+	}
+
+	std::vector<float> pointVertexCounts(lod.m_pointToVertices.size(), 0.0f);
+	for (auto pointIndex: lod.m_vertexToPoints) {
+		pointVertexCounts[pointIndex] += 1.0f;
+	}
+	std::vector<float> newMasses;
+	newMasses.reserve(lod.m_positions.size());
+	for (size_t vertexIndex = 0u;vertexIndex < lod.m_positions.size();++vertexIndex) {
+		const auto pointIndex  = lod.m_vertexToPoints[vertexIndex];
+		const auto vextexCount = pointVertexCounts[pointIndex];
+		newMasses.push_back(shape.GetMasses()[pointIndex] / vextexCount);
+	}
+	return newMasses;
+}
+
+// What WriteLodMLOD wrote for one LOD, kept to verify the output
+struct WrittenLod {
+	const LodShape* source;
+	std::optional<LodShape> transformed; // the copy that was written instead of the source, if any
+	LodType resolution;
+	bool merged;
+	bool remapped;
+
+	const LodShape& Lod() const noexcept { return transformed ? *transformed : *source; }
+};
+
+void WriteLodMLOD(fp::file& out, const Shape& shape, const LodShape& source, LodType lodDistance, size_t lodIndex, int options,
+	WrittenLod* written = nullptr) {
+	const bool merge_source = options & OPTION_MERGE_POINTS || (options & OPTION_MERGE_POINTS_SELECTIVE && lodDistance.graphical>=1000.0f);
+
+	// Welded or compacted copy, written through the merged point tables
+	std::optional<LodShape> transformed;
+	if (options & OPTION_WELD_POINTS) {
+		transformed = WeldPoints(source, global.weld_epsilon);
+	}
+	if (options & OPTION_DROP_UNUSED_POINTS) {
+		// Points carrying mass are used by the geometry LOD even when no face reaches them
+		std::vector<float> vertexMasses;
+		if ((int)lodIndex == shape.GetGeometryLodIndex() && !shape.GetMasses().empty()) {
+			vertexMasses = VertexMasses(shape, source);
+		}
+		transformed = CompactPoints(transformed ? *transformed : source, transformed || merge_source, vertexMasses);
+	}
+	const bool remapped = transformed.has_value();
+	if (remapped) {
+		RemapAnimationPhases(*transformed);
+	}
+
+	// Component selections of the geometry LOD
+	if ((int)lodIndex == shape.GetGeometryLodIndex() && options & (OPTION_CONVEX_COMPONENTS | OPTION_CONVEX_HULLS)) {
+		if (!transformed) {
+			transformed = source;
+		}
+		BuildConvexComponents(*transformed, options & OPTION_CONVEX_HULLS);
+	}
+
+	// Reordered faces
+	if (options & (OPTION_SORT_FACES | OPTION_VERTEX_CACHE)) {
+		if (!transformed) {
+			transformed = source;
+		}
+		const bool reordered = options & OPTION_VERTEX_CACHE ? OptimizeFaceOrder(*transformed) : SortFacesByTexture(*transformed);
+		if (!reordered) {
+			std::cout << "LOD " << FormatLodType(lodDistance) << ": faces not reordered, a selection would point past face 65535" << std::endl;
+		}
+	}
+	const LodShape& lod = transformed ? *transformed : source;
+
+	uint32_t quadCount = 0u;
+	for (const auto& face : lod.GetOriginalFaces()) {
+		quadCount += face.IsQuad() ? 1u : 0u;
+	}
+	const uint32_t normalCount = 3u * lod.GetOriginalFaces().size() + quadCount;
+
+	bool merge_this_lod = merge_source || remapped;
+
+	NormalTable normalTable;
+	if (options & OPTION_UNIQUE_NORMALS) {
+		normalTable = DeduplicateNormals(lod, normalCount);
+	}
+	
+	// MLOD_LOD
+	out.write(fp::to_bytes(signature_sp3x));
+	out.write(fp::to_bytes(static_cast<uint32_t>(0x1c)));
+	out.write(fp::to_bytes(static_cast<uint32_t>(0x99)));
+	uint16_t positonsCount = merge_this_lod ? lod.GetPointToVertices().size() : lod.GetPositions().size();
+	out.write(fp::to_bytes(static_cast<uint32_t>(positonsCount)));
+	out.write(fp::to_bytes(options & OPTION_UNIQUE_NORMALS ? static_cast<uint32_t>(normalTable.normals.size()) : normalCount));
+	out.write(fp::to_bytes(static_cast<uint32_t>(lod.GetOriginalFaces().size())));
+	out.write(fp::to_bytes(static_cast<uint32_t>(0x00)));
+
+	FACE_LAYOUT layout = FACE_LAYOUT_MIXED;
+	if (quadCount == 0u) {
+		layout = FACE_LAYOUT_TRIANGLES;
+	} else if (quadCount == lod.GetOriginalFaces().size()) {
+		layout = FACE_LAYOUT_QUADS;
+	}
+
+	SelectLodGeometryWriter(merge_this_lod, options & OPTION_ONLY_USER_VALUE, layout)(out, shape, lod, normalCount,
+		options & OPTION_UNIQUE_NORMALS ? &normalTable : nullptr);
+
+	out.write(fp::to_bytes(signature_tagg));
+
+	// Named sections
+	{
+		// Every block has the same size: name, size, point weights and face membership. Workers fill their
+		// sections into a per-thread zeroed block and copy it to the section's offset in the output buffer.
+		// Only the entries a section sets are cleared again, so the cost follows the selection size.
+		constexpr size_t nameSize = 64u;
+		const auto namedSectionSize = static_cast<uint32_t>(positonsCount + lod.GetOriginalFaces().size());
+		const size_t blockSize = nameSize + sizeof(namedSectionSize) + namedSectionSize;
+		const auto& sections = lod.GetNamedSections();
+		std::vector<uint8_t> blocks(sections.size() * blockSize);
+
+		const auto point = [&](uint16_t index) {
+			return merge_this_lod ? lod.VertexToPoint(index) : index;
+		};
+
+		ParallelFor(sections.size(), 4u, [&](size_t begin, size_t end) {
+			std::vector<uint8_t> block(blockSize, 0u);
+			std::memcpy(block.data() + nameSize, &namedSectionSize, sizeof(namedSectionSize));
+			const auto name = block.begin();
+			const auto sectionWeights = name + nameSize + sizeof(namedSectionSize);
+			const auto isFaceInSection = sectionWeights + positonsCount;
+
+			for (size_t i = begin; i < end; ++i) {
+				const auto& sec = sections[i];
+				const auto nameLength = std::min(sec.name.size(), nameSize - 1u);
+				std::copy_n(sec.name.begin(), nameLength, name);
+
+				if (sec.vertexWeights.empty()) {
+					for (auto index : sec.vertexIndices) {
+						sectionWeights[point(index)] = 0x01;
+					}
+				} else {
+					for (auto [weight, index] : fp::zip(sec.vertexWeights, sec.vertexIndices)) {
+						sectionWeights[point(index)] = -weight; // why
+					}
+				}
+
+				for (auto faceIndex : sec.faceIndices) {
+					isFaceInSection[faceIndex] = 1u;
+				}
+
+				std::copy(block.begin(), block.end(), blocks.begin() + i * blockSize);
+
+				std::fill_n(name, nameLength, 0u);
+				for (auto index : sec.vertexIndices) {
+					sectionWeights[point(index)] = 0u;
+				}
+				for (auto faceIndex : sec.faceIndices) {
+					isFaceInSection[faceIndex] = 0u;
+				}
+			}
+		});
+
+		out.write(blocks);
+	}
+
+	// Sharp edges
+	if (options & OPTION_SHARP_EDGES) {
+		const auto sharpEdges = FindSharpEdges(lod, merge_this_lod);
+		if (!sharpEdges.empty()) {
+			WriteName<64>(out, "#SharpEdges#");
+			out.write(fp::to_bytes(static_cast<uint32_t>(4u * sharpEdges.size())));
+			out.write(sharpEdges);
+		}
+	}
+
+	// Properties
+	for (const auto& prop : lod.GetNamedProperties()) {
+		WriteName<64>(out, "#Property#");
+		out.write(fp::to_bytes(static_cast<uint32_t>(128)));
+		WriteName<64>(out, prop.name);
+		WriteName<64>(out, prop.value);
+	}
+
+	// Mass
+	if ((int)lodIndex == shape.GetGeometryLodIndex() && !shape.GetMasses().empty()) {
+		WriteName<64>(out, "#Mass#");
+		
+		if (remapped) {
+			const auto vertexMasses = VertexMasses(shape, source);
+			std::vector<float> pointMasses(lod.m_pointToVertices.size(), 0.0f);
+			for (size_t vertexIndex = 0u; vertexIndex < vertexMasses.size(); ++vertexIndex) {
+				if (lod.m_vertexToPoints[vertexIndex] != NO_POINT) {
+					pointMasses[lod.m_vertexToPoints[vertexIndex]] += vertexMasses[vertexIndex];
+				}
+			}
+			out.write(fp::to_bytes(static_cast<uint32_t>(4u * pointMasses.size())));
+			out.write(pointMasses);
+		} else if (merge_this_lod) {
+			out.write(fp::to_bytes(static_cast<uint32_t>(4u * shape.GetMasses().size())));
+			out.write(shape.GetMasses());
+		} else {
+			const auto newMasses = VertexMasses(shape, lod);
+			out.write(fp::to_bytes(static_cast<uint32_t>(4u * newMasses.size())));
+			out.write(newMasses);
+		}
+	}
+	
+	// Animations
+	for (size_t j=0; j<lod.m_animationPhases.size(); j++) {
+		WriteName<64>(out, "#Animation#");
+		uint32_t tagg_size = sizeof(lod.m_animationPhases[j].time) + 3u * lod.m_animationPhases[j].points.size() * sizeof(float);
+		out.write(fp::to_bytes(static_cast<uint32_t>(tagg_size)));
+		out.write(fp::to_bytes(lod.m_animationPhases[j].time));
+		
+		for (size_t k=0; k<lod.m_animationPhases[j].points.size(); k++) {
+			out.write(fp::to_bytes(lod.m_animationPhases[j].points[k].X()));
+			out.write(fp::to_bytes(lod.m_animationPhases[j].points[k].Y()));
+			out.write(fp::to_bytes(lod.m_animationPhases[j].points[k].Z()));
+		}
+	}
+
+	// Close LOD
+	WriteName<64>(out, "#EndOfFile#");
+	out.write(fp::to_bytes(static_cast<uint32_t>(0)));
+	out.write(fp::to_bytes(lodDistance));
+
+	if (written) {
+		*written = {&source, std::move(transformed), lodDistance, merge_this_lod, remapped};
+	}
+}
+
+// Sum of squared distances to a set of planes ax + by + cz + d = 0
+struct Quadric {
+	double a2 = 0.0, ab = 0.0, ac = 0.0, ad = 0.0, b2 = 0.0, bc = 0.0, bd = 0.0, c2 = 0.0, cd = 0.0, d2 = 0.0;
+
+	void AddPlane(const Vector3F& normal, const Vector3F& point, double weight) noexcept {
+		const double a = normal.X(), b = normal.Y(), c = normal.Z();
+		const double d = -(a * point.X() + b * point.Y() + c * point.Z());
+		a2 += weight * a * a; ab += weight * a * b; ac += weight * a * c; ad += weight * a * d;
+		b2 += weight * b * b; bc += weight * b * c; bd += weight * b * d;
+		c2 += weight * c * c; cd += weight * c * d;
+		d2 += weight * d * d;
+	}
+
+	void operator += (const Quadric& other) noexcept {
+		a2 += other.a2; ab += other.ab; ac += other.ac; ad += other.ad; b2 += other.b2;
+		bc += other.bc; bd += other.bd; c2 += other.c2; cd += other.cd; d2 += other.d2;
+	}
+
+	double Error(const Vector3F& p) const noexcept {
+		const double x = p.X(), y = p.Y(), z = p.Z();
+		return std::max(0.0, a2 * x * x + 2.0 * ab * x * y + 2.0 * ac * x * z + 2.0 * ad * x + b2 * y * y
+			+ 2.0 * bc * y * z + 2.0 * bd * y + c2 * z * z + 2.0 * cd * z + d2);
+	}
+};
+
+// Copy of a graphical LOD reduced to about targetFaces triangles by half-edge collapses taken from a heap in
+// order of quadric error. Vertices at one position form a group sharing a quadric: a lone vertex collapses
+// freely or, on an open border, only along the border; the two vertices of a UV or normal seam collapse
+// together along the seam; anything else stays. Collapses that would turn a triangle more than about
+// 78 degrees away from its original facing are skipped.
+LodShape DecimateLod(const LodShape& source, size_t targetFaces) {
+	constexpr uint32_t none = 0xFFFFFFFFu;
+	constexpr double borderWeight = 10.0;
+	const auto& positions = source.GetPositions();
+	const size_t vertexCount = positions.size();
+
+	// Triangles, quads are split in two
+	std::vector<std::array<uint32_t, 3>> triangles;
+	std::vector<uint32_t> triangleFaces;
+	for (size_t i = 0u; i < source.GetOriginalFaces().size(); ++i) {
+		const auto& face = source.GetOriginalFaces()[i];
+		triangles.push_back({face.v0, face.v1, face.v2});
+		triangleFaces.push_back(static_cast<uint32_t>(i));
+		if (face.IsQuad()) {
+			triangles.push_back({face.v0, face.v2, face.v3});
+			triangleFaces.push_back(static_cast<uint32_t>(i));
+		}
+	}
+
+	const PositionGroups groups = GroupPositions(positions);
+	const auto& group = groups.group;
+	const auto& members = groups.members;
+
+	const auto edgeKey = [&](uint32_t a, uint32_t b) {
+		const uint32_t ga = group[a], gb = group[b];
+		return static_cast<uint64_t>(std::min(ga, gb)) << 32 | std::max(ga, gb);
+	};
+	std::unordered_map<uint64_t, uint32_t> edgeFaces;
+	edgeFaces.reserve(3u * triangles.size());
+	for (const auto& t : triangles) {
+		for (size_t k = 0u; k < 3u; ++k) {
+			++edgeFaces[edgeKey(t[k], t[(k + 1u) % 3u])];
+		}
+	}
+
+	enum KIND : uint8_t { KIND_MANIFOLD, KIND_BORDER, KIND_SEAM, KIND_LOCKED };
+	std::vector<uint8_t> kinds(vertexCount, KIND_MANIFOLD);
+	std::vector<Quadric> quadrics(members.size());
+	std::vector<std::vector<uint32_t>> adjacent(vertexCount);
+	std::vector<Vector3F> normals(triangles.size());
+
+	for (size_t i = 0u; i < triangles.size(); ++i) {
+		const auto& t = triangles[i];
+		const Vector3F cross = (positions[t[1]] - positions[t[0]]).Cross(positions[t[2]] - positions[t[0]]);
+		const float area2 = cross.Size();
+		const Vector3F normal = area2 > 0.0f ? cross / area2 : Vector3F();
+		normals[i] = normal;
+
+		for (size_t k = 0u; k < 3u; ++k) {
+			adjacent[t[k]].push_back(static_cast<uint32_t>(i));
+			quadrics[group[t[k]]].AddPlane(normal, positions[t[0]], 0.5 * area2);
+
+			const uint32_t a = t[k], b = t[(k + 1u) % 3u];
+			const uint32_t count = edgeFaces[edgeKey(a, b)];
+			if (count == 1u) {
+				// Open border, keep the surface from shrinking away from it
+				const Vector3F edge = positions[b] - positions[a];
+				Vector3F side = edge.Cross(normal);
+				const float length = side.Size();
+				if (length > 0.0f) {
+					side /= length;
+					quadrics[group[a]].AddPlane(side, positions[a], borderWeight * edge.Size2());
+					quadrics[group[b]].AddPlane(side, positions[a], borderWeight * edge.Size2());
+				}
+				kinds[a] = std::max<uint8_t>(kinds[a], KIND_BORDER);
+				kinds[b] = std::max<uint8_t>(kinds[b], KIND_BORDER);
+			} else if (count > 2u) {
+				kinds[a] = kinds[b] = KIND_LOCKED;
+			}
+		}
+	}
+	for (size_t v = 0u; v < vertexCount; ++v) {
+		const size_t size = members[group[v]].size();
+		if (size == 2u && kinds[v] == KIND_MANIFOLD) {
+			kinds[v] = KIND_SEAM;
+		} else if (size > 1u) {
+			kinds[v] = KIND_LOCKED;
+		}
+	}
+
+	std::vector<uint8_t> triangleAlive(triangles.size(), 1u);
+	std::vector<uint8_t> vertexAlive(vertexCount, 1u);
+	size_t aliveCount = triangles.size();
+
+	// Number of live triangles using both a and b
+	const auto shared = [&](uint32_t a, uint32_t b) {
+		size_t count = 0u;
+		for (auto t : adjacent[a]) {
+			if (triangleAlive[t] && (triangles[t][0] == b || triangles[t][1] == b || triangles[t][2] == b)) {
+				++count;
+			}
+		}
+		return count;
+	};
+	const auto connected = [&](uint32_t a, uint32_t b) {
+		return shared(a, b) != 0u;
+	};
+	const auto twin = [&](uint32_t v) {
+		const auto& m = members[group[v]];
+		return m[0] == v ? m[1] : m[0];
+	};
+	// Vertex of b's group that a's seam twin connects to
+	const auto seamTarget = [&](uint32_t a, uint32_t b) {
+		const uint32_t a2 = twin(a);
+		for (auto b2 : members[group[b]]) {
+			if (b2 != b && connected(a2, b2)) {
+				return b2;
+			}
+		}
+		return connected(a2, b) ? b : none;
+	};
+	const auto allowed = [&](uint32_t a, uint32_t b) {
+		switch (kinds[a]) {
+			case KIND_MANIFOLD : return true;
+			case KIND_BORDER   : return edgeFaces[edgeKey(a, b)] == 1u;
+			case KIND_SEAM     : return kinds[b] == KIND_SEAM && seamTarget(a, b) != none;
+			default            : return false;
+		}
+	};
+	// Moving a onto b must not turn any remaining triangle of a too far from its original facing
+	const auto flips = [&](uint32_t a, uint32_t b) {
+		for (auto t : adjacent[a]) {
+			const auto& tri = triangles[t];
+			if (!triangleAlive[t] || tri[0] == b || tri[1] == b || tri[2] == b) {
+				continue;
+			}
+			Vector3F p[3] = {positions[tri[0]], positions[tri[1]], positions[tri[2]]};
+			p[tri[0] == a ? 0 : tri[1] == a ? 1 : 2] = positions[b];
+			const Vector3F after = (p[1] - p[0]).Cross(p[2] - p[0]);
+			if (normals[t].Dot(after) <= 0.2f * std::sqrt(after.Size2())) {
+				return true;
+			}
+		}
+		return false;
+	};
+
+	struct Candidate {
+		double cost;
+		uint32_t from;
+		uint32_t to;
+		uint32_t version;
+		bool operator<(const Candidate& other) const noexcept { return cost > other.cost; }
+	};
+	std::vector<Candidate> heap;
+	std::vector<uint32_t> versions(vertexCount, 0u);
+
+	const auto push = [&](uint32_t a) {
+		if (!vertexAlive[a] || kinds[a] == KIND_LOCKED) {
+			return;
+		}
+		Candidate best = {DBL_MAX, a, none, versions[a]};
+		for (auto t : adjacent[a]) {
+			if (!triangleAlive[t]) {
+				continue;
+			}
+			for (auto b : triangles[t]) {
+				if (b != a && group[b] != group[a] && allowed(a, b)) {
+					Quadric q = quadrics[group[a]];
+					q += quadrics[group[b]];
+					const double cost = q.Error(positions[b]);
+					if (cost < best.cost) {
+						best.cost = cost;
+						best.to = b;
+					}
+				}
+			}
+		}
+		if (best.to != none) {
+			heap.push_back(best);
+			std::push_heap(heap.begin(), heap.end());
+		}
+	};
+
+	for (uint32_t v = 0u; v < vertexCount; ++v) {
+		push(v);
+	}
+
+	std::vector<uint32_t> touched;
+	const auto collapse = [&](uint32_t a, uint32_t b) {
+		vertexAlive[a] = 0u;
+		for (auto t : adjacent[a]) {
+			if (!triangleAlive[t]) {
+				continue;
+			}
+			auto& tri = triangles[t];
+			if (tri[0] == b || tri[1] == b || tri[2] == b) {
+				triangleAlive[t] = 0u;
+				--aliveCount;
+			} else {
+				for (auto& v : tri) {
+					v = v == a ? b : v;
+				}
+				adjacent[b].push_back(t);
+			}
+			for (auto v : tri) {
+				touched.push_back(v);
+			}
+		}
+	};
+
+	while (aliveCount > targetFaces && !heap.empty()) {
+		std::pop_heap(heap.begin(), heap.end());
+		const Candidate candidate = heap.back();
+		heap.pop_back();
+
+		const uint32_t a = candidate.from, b = candidate.to;
+		if (!vertexAlive[a] || !vertexAlive[b] || candidate.version != versions[a]) {
+			continue;
+		}
+
+		uint32_t a2 = none, b2 = none;
+		if (kinds[a] == KIND_SEAM) {
+			a2 = twin(a);
+			b2 = seamTarget(a, b);
+			if (!vertexAlive[a2] || b2 == none || !vertexAlive[b2] || flips(a2, b2)) {
+				continue;
+			}
+		}
+		// Never collapse the last triangles away
+		const size_t removed = shared(a, b) + (a2 != none && a2 != b2 ? shared(a2, b2) : 0u);
+		if (removed >= aliveCount || flips(a, b)) {
+			continue;
+		}
+
+		touched.clear();
+		collapse(a, b);
+		if (a2 != none && a2 != b2) {
+			collapse(a2, b2);
+		}
+		quadrics[group[b]] += quadrics[group[a]];
+
+		std::sort(touched.begin(), touched.end());
+		touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+		for (auto v : touched) {
+			++versions[v];
+			push(v);
+		}
+	}
+
+	// Remaining triangles keep the texture, flags and selections of the face they came from
+	LodShape decimated = source;
+	decimated.m_orignalFaces.clear();
+	std::vector<uint32_t> sourceFaces;
+	for (size_t i = 0u; i < triangles.size(); ++i) {
+		if (triangleAlive[i]) {
+			const auto& face = source.GetOriginalFaces()[triangleFaces[i]];
+			const auto& t = triangles[i];
+			decimated.m_orignalFaces.emplace_back(face.flags, face.textureIndex, 0u, static_cast<uint16_t>(t[0]),
+				static_cast<uint16_t>(t[1]), static_cast<uint16_t>(t[2]));
+			sourceFaces.push_back(triangleFaces[i]);
+		}
+	}
+
+	std::vector<int> weights(source.GetOriginalFaces().size());
+	for (auto& sec : decimated.m_namedSections) {
+		std::fill(weights.begin(), weights.end(), -1);
+		for (size_t j = 0u; j < sec.faceIndices.size(); ++j) {
+			weights[sec.faceIndices[j]] = j < sec.faceWeights.size() ? sec.faceWeights[j] : 0;
+		}
+
+		const bool weighted = !sec.faceWeights.empty();
+		sec.faceIndices.clear();
+		sec.faceWeights.clear();
+		sec.faceSelectionIndices.clear();
+		sec.faceSelectionIndices2.clear();
+		for (size_t i = 0u; i < sourceFaces.size(); ++i) {
+			if (weights[sourceFaces[i]] >= 0) {
+				sec.faceIndices.push_back(static_cast<uint16_t>(i));
+				if (weighted) {
+					sec.faceWeights.push_back(static_cast<uint8_t>(weights[sourceFaces[i]]));
+				}
+			}
+		}
+	}
+
+	decimated.BuildFaceTable();
+	return decimated;
+}
+
+// Extra LODs built from the last graphical LOD, one per ODOL2MLOD_LOD_BUDGETS entry: fractions of its
+// face count, or face counts when above 1
+struct DecimationPlan {
+	int sourceIndex = -1;
+	float resolution = 0.0f; // highest graphical resolution, the generated LODs go above it
+	std::vector<float> budgets;
+};
+
+DecimationPlan PlanDecimation(const Shape& shape, int options) {
+	DecimationPlan plan;
+	if (~options & OPTION_DECIMATE) {
+		return plan;
+	}
+
+	for (size_t i = 0u; i < shape.GetLodDistances().size(); ++i) {
+		if (shape.GetLodDistances()[i].graphical < 1000.0f) {
+			plan.sourceIndex = static_cast<int>(i);
+			plan.resolution = std::max(plan.resolution, shape.GetLodDistances()[i].graphical);
+		}
+	}
+	if (plan.sourceIndex < 0) {
+		return plan;
+	}
+
+	std::string budgets = "0.5,0.25";
+	if (const char* env = std::getenv("ODOL2MLOD_LOD_BUDGETS")) {
+		budgets = env;
+	}
+	std::stringstream ss(budgets);
+	for (std::string item; std::getline(ss, item, ',');) {
+		const float budget = static_cast<float>(std::atof(item.c_str()));
+		if (budget > 0.0f) {
+			plan.budgets.push_back(budget);
+		}
+	}
+
+	// Each generated LOD takes a whole resolution of its own between the graphical LODs and 1000
+	const size_t freeResolutions = plan.resolution < 999.0f ? static_cast<size_t>(999.0f - std::floor(plan.resolution)) : 0u;
+	if (plan.budgets.size() > freeResolutions) {
+		std::cout << "Decimation: " << plan.budgets.size() - freeResolutions << " LOD budget(s) left out, no free resolution between " <<
+			plan.resolution << " and 1000" << std::endl;
+		plan.budgets.resize(freeResolutions);
+	}
+	return plan;
+}
+
+struct DecimatedLod {
+	LodShape lod;
+	LodType resolution;
+};
+
+// Decimated copies of the plan's source LOD, counted in triangles as DecimateLod counts them. A copy that
+// ends up with no fewer triangles than its source is reported and left out.
+std::vector<DecimatedLod> DecimateLods(const LodShape& source, const DecimationPlan& plan) {
+	size_t sourceTriangles = 0u;
+	for (const auto& face : source.GetOriginalFaces()) {
+		sourceTriangles += face.IsQuad() ? 2u : 1u;
+	}
+	float resolution = plan.resolution;
+
+	std::vector<DecimatedLod> lods;
+	for (size_t i = 0u; i < plan.budgets.size(); ++i) {
+		const float budget = plan.budgets[i];
+		const size_t targetFaces = std::max<size_t>(budget > 1.0f ? static_cast<size_t>(budget) : static_cast<size_t>(budget * sourceTriangles), 1u);
+		LodShape decimated = DecimateLod(source, targetFaces);
+		const size_t faceCount = decimated.GetOriginalFaces().size();
+		if (faceCount >= sourceTriangles) {
+			std::cout << "Decimation: LOD budget " << budget << " left out, " << faceCount << " of " << sourceTriangles <<
+				" triangles left" << std::endl;
+			continue;
+		}
+
+		// Resolution grows with the face reduction, stays above the previous graphical LOD and leaves one
+		// whole resolution below 1000 for each LOD still to come
+		const float ratio = static_cast<float>(sourceTriangles) / std::max<size_t>(faceCount, 1u);
+		const float highest = 999.0f - static_cast<float>(plan.budgets.size() - 1u - i);
+		resolution = std::min(std::max(std::round(resolution * ratio), std::floor(resolution) + 1.0f), highest);
+
+		LodType lodDistance;
+		lodDistance.graphical = resolution;
+		lods.push_back({std::move(decimated), lodDistance});
+	}
+	return lods;
+}
+
+void WriteDecimatedLodsMLOD(fp::file& out, const Shape& shape, const std::vector<DecimatedLod>& lods, int options,
+	std::vector<WrittenLod>* written = nullptr) {
+	for (size_t i = 0u; i < lods.size(); ++i) {
+		WriteLodMLOD(out, shape, lods[i].lod, lods[i].resolution, shape.GetLodDistances().size() + i, options | OPTION_DROP_UNUSED_POINTS,
+			written ? &written->emplace_back() : nullptr);
+	}
+}
+
+void WriteMLOD(fp::file& out, const Shape& shape, int options, std::vector<WrittenLod>* written = nullptr) {
+	const auto plan = PlanDecimation(shape, options);
+	const auto decimated = plan.budgets.empty() ? std::vector<DecimatedLod>() : DecimateLods(shape.GetLods()[plan.sourceIndex], plan);
+	WriteHeaderMLOD(out, shape.GetLods().size() + decimated.size());
+
+	for (auto [lod, lodDistance, lodIndex] : fp::zip_index(shape.GetLods(), shape.GetLodDistances())) {
+		WriteLodMLOD(out, shape, lod, lodDistance, lodIndex, options, written ? &written->emplace_back() : nullptr);
+	}
+
+	WriteDecimatedLodsMLOD(out, shape, decimated, options, written);
+}
+
+// Parses, writes and frees one LOD at a time, using the LOD offsets of a shape read without FIELD_LODS
+void WriteMLODStreamed(fp::file& out, fp::file& file, const Shape& shape, int fields, int options) {
+	// The header counts the decimated LODs, so they are made first and only they are kept through the others
+	const auto plan = PlanDecimation(shape, options);
+	std::vector<DecimatedLod> decimated;
+	if (!plan.budgets.empty()) {
+		file.seek(shape.GetLodOffsets()[plan.sourceIndex], SEEK_SET);
+		decimated = DecimateLods(LodShape(file, fields), plan);
+	}
+	WriteHeaderMLOD(out, shape.GetLodOffsets().size() + decimated.size());
+
+	for (auto [offset, lodDistance, lodIndex] : fp::zip_index(shape.GetLodOffsets(), shape.GetLodDistances())) {
+		file.seek(offset, SEEK_SET);
+		const LodShape lod(file, fields);
+		WriteLodMLOD(out, shape, lod, lodDistance, lodIndex, options);
+	}
+
+	WriteDecimatedLodsMLOD(out, shape, decimated, options);
+}
+
+// Compares an MLOD read back with what was written for each LOD: points with the LOD center added, face
+// corners, normals and UVs, textures, selections, mass and properties. Prints the first problems and
+// returns how many there were.
+size_t VerifyMLOD(const Shape& shape, const ShapeMLOD& mlod, const std::vector<WrittenLod>& written, int options) {
+	size_t problems = 0u;
+	std::ostringstream report;
+	const auto problem = [&](const std::string& lod) -> std::ostream& {
+		++problems;
+		report.str("");
+		return report << "Verify: LOD " << lod << ": ";
+	};
+	const auto flush = [&]() {
+		if (problems <= 10u) {
+			std::cout << report.str() << std::endl;
+		}
+	};
+	const auto same = [](const auto& a, const auto& b) { return std::memcmp(&a, &b, sizeof(a)) == 0; };
+
+	if (mlod.lods.size() != written.size()) {
+		problem("-") << mlod.lods.size() << " LODs read, " << written.size() << " written";
+		flush();
+		return problems;
+	}
+
+	const bool only_user_value = options & OPTION_ONLY_USER_VALUE;
+	for (size_t i = 0u; i < written.size(); ++i) {
+		const auto& w = written[i];
+		const auto& lod = w.Lod();
+		const auto& read = mlod.lods[i];
+		const std::string name = FormatLodType(w.resolution);
+		const auto point = [&](uint32_t vertex) -> uint32_t { return w.merged ? lod.VertexToPoint(vertex) : vertex; };
+
+		if (read.signature != signature_sp3x || !same(read.resolution, w.resolution)) {
+			problem(name) << "signature or resolution differs";
+			flush();
+			continue;
+		}
+
+		// Points
+		const size_t pointCount = w.merged ? lod.GetPointToVertices().size() : lod.GetPositions().size();
+		if (read.points.size() != pointCount) {
+			problem(name) << read.points.size() << " points, expected " << pointCount;
+			flush();
+			continue;
+		}
+		for (size_t p = 0u; p < pointCount; ++p) {
+			const size_t vertex = w.merged ? lod.GetPointToVertices()[p] : p;
+			const Vector3F position = lod.GetPositions()[vertex] + shape.GetLodCenter();
+			const uint32_t flags = only_user_value ? convert_point_light_flags<true>(lod.GetFlags()[vertex])
+				: convert_point_light_flags<false>(lod.GetFlags()[vertex]);
+			if (!same(read.points[p].pos, position) || read.points[p].flags != flags) {
+				problem(name) << "point " << p << " differs from vertex " << vertex;
+				flush();
+			}
+		}
+
+		// Faces
+		const auto& faces = lod.GetOriginalFaces();
+		if (read.faces.size() != faces.size()) {
+			problem(name) << read.faces.size() << " faces, expected " << faces.size();
+			flush();
+			continue;
+		}
+		const auto& corners = lod.GetFaceTable().corners;
+		for (size_t f = 0u; f < faces.size(); ++f) {
+			const auto& face = faces[f];
+			const auto& readFace = read.faces[f];
+			const std::string texture = face.textureIndex < lod.GetTextureNames().size()
+				? lod.GetTextureNames()[face.textureIndex].substr(0u, 31u) : std::string();
+			if (readFace.type != (face.IsQuad() ? 4 : 3) || readFace.texture != texture
+				|| static_cast<uint32_t>(readFace.flags) != convert_face_flags(face.flags)) {
+				problem(name) << "face " << f << " type, texture or flags differ";
+				flush();
+				continue;
+			}
+			for (int k = 0; k < readFace.type; ++k) {
+				const uint32_t vertex = corners[4u * f + k];
+				const auto& corner = readFace.table[k];
+				const auto& normal = lod.GetNormals()[vertex];
+				const bool normalOk = corner.normals_index >= 0 && static_cast<size_t>(corner.normals_index) < read.normals.size()
+					&& (options & OPTION_UNIQUE_NORMALS ? (read.normals[corner.normals_index] - normal).Size2() <= 1e-8f
+						: same(read.normals[corner.normals_index], normal));
+				if (static_cast<uint32_t>(corner.points_index) != point(vertex) || !normalOk
+					|| !same(corner.u, lod.GetUvs()[vertex].X()) || !same(corner.v, lod.GetUvs()[vertex].Y())) {
+					problem(name) << "face " << f << " corner " << k << " differs from vertex " << vertex;
+					flush();
+				}
+			}
+		}
+
+		// Selections, rebuilt the way the writer fills them
+		std::unordered_map<std::string, const NamedSelectionMLOD*> selections;
+		size_t selection = 0u;
+		for (const auto& tag : read.tags) {
+			if (!tag.empty() && tag[0] != '#' && selection < read.named_selections.size()) {
+				selections.emplace(tag, &read.named_selections[selection++]);
+			}
+		}
+		for (const auto& sec : lod.GetNamedSections()) {
+			const auto found = selections.find(sec.name.substr(0u, 63u));
+			if (found == selections.end()) {
+				problem(name) << "selection " << sec.name << " missing";
+				flush();
+				continue;
+			}
+			std::vector<uint8_t> points(pointCount, 0u), faceFlags(faces.size(), 0u);
+			for (size_t j = 0u; j < sec.vertexIndices.size(); ++j) {
+				points[point(sec.vertexIndices[j])] = sec.vertexWeights.empty() ? 0x01 : static_cast<uint8_t>(-sec.vertexWeights[j]);
+			}
+			for (auto faceIndex : sec.faceIndices) {
+				faceFlags[faceIndex] = 1u;
+			}
+			if (found->second->point != points || found->second->face != faceFlags) {
+				problem(name) << "selection " << sec.name << " differs";
+				flush();
+			}
+		}
+
+		// Properties
+		std::vector<std::string> properties;
+		for (const auto& prop : lod.GetNamedProperties()) {
+			properties.push_back(prop.name.substr(0u, 63u));
+			properties.push_back(prop.value.substr(0u, 63u));
+		}
+		if (read.properties != properties) {
+			problem(name) << "properties differ";
+			flush();
+		}
+
+		// Mass, points may be merged so only the total is kept
+		if (static_cast<int>(i) == shape.GetGeometryLodIndex() && !shape.GetMasses().empty()) {
+			double expected = 0.0, total = 0.0;
+			for (auto mass : shape.GetMasses()) {
+				expected += mass;
+			}
+			for (auto mass : read.mass) {
+				total += mass;
+			}
+			if (read.mass.size() != pointCount || std::fabs(total - expected) > 1e-4 * std::max(1.0, std::fabs(expected))) {
+				problem(name) << "mass " << total << " over " << read.mass.size() << " points, expected " << expected;
+				flush();
+			}
+		}
+	}
+
+	if (problems > 10u) {
+		std::cout << "Verify: " << problems - 10u << " more problems" << std::endl;
+	}
+	return problems;
+}
+
+// Writes the MLOD to memory, reads it back and verifies it. Returns the MLOD bytes, or nothing when it
+// does not match what was written or there is no memory for it.
+std::optional<std::vector<char>> WriteVerifiedMLOD(const Shape& shape, int options) {
+	const auto outOfMemory = [] {
+		std::cout << "Not enough memory to verify the model - error " << errno << ": " << strerror(errno) << std::endl;
+		return std::nullopt;
+	};
+
+	char* buffer = nullptr;
+	size_t size = 0u;
+	std::vector<WrittenLod> written;
+	{
+		fp::file memory(open_memstream(&buffer, &size));
+		if (!memory.is_open()) {
+			return outOfMemory();
+		}
+		WriteMLOD(memory, shape, options, &written);
+		if (memory.flush() != 0 || memory.error()) {
+			memory.close();
+			std::free(buffer);
+			return outOfMemory();
+		}
+	}
+
+	size_t problems = 0u;
+	{
+		// An MLOD is never empty, and fmemopen refuses a size of 0
+		fp::file memory(size > 0u ? fmemopen(buffer, size, "rb") : nullptr);
+		if (!memory.is_open()) {
+			std::free(buffer);
+			return outOfMemory();
+		}
+		uint32_t signature = 0u;
+		ReadValue(signature, memory);
+		const ShapeMLOD mlod(memory);
+		problems = signature == signature_mlod ? VerifyMLOD(shape, mlod, written, options) : 1u;
+	}
+
+	std::optional<std::vector<char>> result;
+	if (problems == 0u) {
+		result.emplace(buffer, buffer + size);
+	}
+	std::free(buffer);
+	return result;
+}
+
+// Writes a LOD in the layout LodShape reads, face sizes and offsets are recounted from the faces
+void WriteLodODOL(fp::file& out, const LodShape& lod) {
+	const auto writeString = [&out](const std::string& text) {
+		out.write(text.c_str(), text.size() + 1u);
+	};
+
+	WriteCompressedArray(lod.m_flags, out);
+	WriteCompressedArray(lod.m_uv, out);
+	out.write(fp::to_bytes(static_cast<uint32_t>(lod.m_positions.size())));
+	out.write(lod.m_positions);
+	out.write(fp::to_bytes(static_cast<uint32_t>(lod.m_normals.size())));
+	out.write(lod.m_normals);
+
+	out.write(fp::to_bytes(lod.m_hintsOr));
+	out.write(fp::to_bytes(lod.m_hintsAnd));
+	out.write(fp::to_bytes(lod.m_min));
+	out.write(fp::to_bytes(lod.m_max));
+	out.write(fp::to_bytes(lod.m_center));
+	out.write(fp::to_bytes(lod.m_radius));
+
+	out.write(fp::to_bytes(static_cast<uint32_t>(lod.m_textureNames.size())));
+	for (const auto& name : lod.m_textureNames) {
+		writeString(name);
+	}
+
+	WriteCompressedArray(lod.m_pointToVertices, out);
+	WriteCompressedArray(lod.m_vertexToPoints, out);
+
+	// Faces
+	{
+		uint32_t size = 0u;
+		for (const auto& face : lod.m_orignalFaces) {
+			size += face.IsQuad() ? 2u + 4u * 2u : 2u + 3u * 2u;
+		}
+		out.write(fp::to_bytes(static_cast<uint32_t>(lod.m_orignalFaces.size())));
+		out.write(fp::to_bytes(size));
+
+		std::vector<uint8_t> faces;
+		faces.reserve(lod.m_orignalFaces.size() * 15u);
+		for (const auto& face : lod.m_orignalFaces) {
+			const auto append = [&faces](const auto& value) {
+				const auto bytes = fp::to_bytes(value);
+				faces.insert(faces.end(), reinterpret_cast<const uint8_t*>(bytes.data()), reinterpret_cast<const uint8_t*>(bytes.data()) + bytes.size());
+			};
+			append(face.flags);
+			append(static_cast<uint16_t>(face.textureIndex));
+			if (face.IsQuad()) {
+				append(uint8_t{4u});
+				append(face.v0), append(face.v1), append(face.v2), append(face.v3);
+			} else {
+				append(uint8_t{3u});
+				append(face.v0), append(face.v1), append(face.v2);
+			}
+		}
+		out.write(faces);
+	}
+
+	out.write(fp::to_bytes(static_cast<uint32_t>(lod.m_sections.size())));
+	for (const auto& section : lod.m_sections) {
+		out.write(fp::to_bytes(section.startIndex));
+		out.write(fp::to_bytes(section.endIndex));
+		out.write(fp::to_bytes(section.material));
+		out.write(fp::to_bytes(section.textureIndex));
+		out.write(fp::to_bytes(section.special));
+	}
+
+	out.write(fp::to_bytes(static_cast<uint32_t>(lod.m_namedSections.size())));
+	for (const auto& section : lod.m_namedSections) {
+		writeString(section.name);
+		WriteCompressedArray(section.faceIndices, out);
+		WriteCompressedArray(section.faceWeights, out);
+		WriteCompressedArray(section.faceSelectionIndices, out);
+		out.write(fp::to_bytes(section.needSelection));
+		WriteCompressedArray(section.faceSelectionIndices2, out);
+		WriteCompressedArray(section.vertexIndices, out);
+		WriteCompressedArray(section.vertexWeights, out);
+	}
+
+	out.write(fp::to_bytes(static_cast<uint32_t>(lod.m_namedProperties.size())));
+	for (const auto& property : lod.m_namedProperties) {
+		writeString(property.name);
+		writeString(property.value);
+	}
+
+	out.write(fp::to_bytes(static_cast<uint32_t>(lod.m_animationPhases.size())));
+	for (const auto& phase : lod.m_animationPhases) {
+		out.write(fp::to_bytes(phase.time));
+		out.write(fp::to_bytes(static_cast<uint32_t>(phase.points.size())));
+		out.write(phase.points);
+	}
+
+	out.write(fp::to_bytes(lod.m_color));
+	out.write(fp::to_bytes(lod.m_color2));
+	out.write(fp::to_bytes(lod.m_flags2));
+
+	out.write(fp::to_bytes(static_cast<uint32_t>(lod.m_proxies.size())));
+	for (const auto& proxy : lod.m_proxies) {
+		writeString(proxy.name);
+		out.write(fp::to_bytes(proxy.transform));
+		out.write(fp::to_bytes(proxy.id));
+		out.write(fp::to_bytes(proxy.sectionIndex));
+	}
+}
+
+// Writes a whole model as ODOL v7, in the layout Shape reads
+void WriteODOL(fp::file& out, const Shape& shape) {
+	out.write(fp::to_bytes(signature_odol));
+	out.write(fp::to_bytes(shape.m_version));
+	out.write(fp::to_bytes(static_cast<uint32_t>(shape.m_lods.size())));
+	for (const auto& lod : shape.m_lods) {
+		WriteLodODOL(out, lod);
+	}
+	out.write(shape.m_lodDistances);
+
+	out.write(fp::to_bytes(shape.m_properties));
+	out.write(fp::to_bytes(shape.m_lodSphere));
+	out.write(fp::to_bytes(shape.m_physicsSphere));
+	out.write(fp::to_bytes(shape.m_properties2));
+	out.write(fp::to_bytes(shape.m_hintsAnd));
+	out.write(fp::to_bytes(shape.m_hintsOr));
+	out.write(fp::to_bytes(shape.m_aimPoint));
+	out.write(fp::to_bytes(shape.m_color));
+	out.write(fp::to_bytes(shape.m_color2));
+	out.write(fp::to_bytes(shape.m_density));
+	out.write(fp::to_bytes(shape.m_min));
+	out.write(fp::to_bytes(shape.m_max));
+	out.write(fp::to_bytes(shape.m_lodCenter));
+	out.write(fp::to_bytes(shape.m_physicsCenter));
+	out.write(fp::to_bytes(shape.m_massCenter));
+	out.write(fp::to_bytes(shape.m_invInertia));
+	out.write(fp::to_bytes(shape.m_autoCenter));
+	out.write(fp::to_bytes(shape.m_autoCenter2));
+	out.write(fp::to_bytes(shape.m_canOcclude));
+	out.write(fp::to_bytes(shape.m_canBeOccluded));
+	out.write(fp::to_bytes(shape.m_allowAnimation));
+	out.write(fp::to_bytes(shape.m_mapType));
+	WriteCompressedArray(shape.m_masses, out);
+	out.write(fp::to_bytes(shape.m_mass));
+	out.write(fp::to_bytes(shape.m_invMass));
+	out.write(fp::to_bytes(shape.m_armor));
+	out.write(fp::to_bytes(shape.m_invArmor));
+
+	for (const int8_t index : {shape.m_memoryLodIndex, shape.m_geometryLodIndex, shape.m_geometryFireLodIndex,
+		shape.m_geometryViewLodIndex, shape.m_geometryViewPilotLodIndex, shape.m_geometryViewGunnerLodIndex,
+		shape.m_geometryViewCommanderLodIndex, shape.m_geometryViewCargoLodIndex, shape.m_landContactLodIndex,
+		shape.m_roadwayLodIndex, shape.m_pathsLodIndex, shape.m_hitpointsLodIndex}) {
+		out.write(fp::to_bytes(index));
+	}
+}
+
+// Drops what a dedicated server never reads: the graphical LODs and, with -X, the selections that select nothing
+// and the animation phases outside the geometry and fire geometry LODs. Returns false if no LOD would be left.
+bool StripShapeForServer(Shape& shape, int options) {
+	const auto keep = [&shape](size_t i) { return shape.m_lodDistances[i].graphical >= 1000.0f; };
+	std::vector<int8_t> remap(shape.m_lods.size(), -1);
+	int8_t kept = 0;
+	for (size_t i = 0u; i < shape.m_lods.size(); ++i) {
+		if (keep(i)) {
+			remap[i] = kept++;
+		}
+	}
+	if (kept == 0) {
+		std::cout << "No LOD left without the graphical ones" << std::endl;
+		return false;
+	}
+
+	for (size_t i = 0u; i < shape.m_lods.size(); ++i) {
+		auto& lod = shape.m_lods[i];
+		if (!keep(i) || ~options & OPTION_SERVER_STRIP) {
+			continue;
+		}
+
+		if (static_cast<int>(i) != shape.m_geometryLodIndex && static_cast<int>(i) != shape.m_geometryFireLodIndex) {
+			lod.m_animationPhases.clear();
+		}
+
+		// Proxies point at their selection by index, so theirs are kept even when empty
+		std::vector<int32_t> sections(lod.m_namedSections.size(), -1);
+		std::vector<bool> used(lod.m_namedSections.size(), false);
+		for (const auto& proxy : lod.m_proxies) {
+			if (proxy.sectionIndex >= 0 && static_cast<size_t>(proxy.sectionIndex) < used.size()) {
+				used[proxy.sectionIndex] = true;
+			}
+		}
+		std::vector<NamedSection> namedSections;
+		for (size_t j = 0u; j < lod.m_namedSections.size(); ++j) {
+			auto& section = lod.m_namedSections[j];
+			if (used[j] || !section.vertexIndices.empty() || !section.faceIndices.empty()) {
+				sections[j] = static_cast<int32_t>(namedSections.size());
+				namedSections.push_back(std::move(section));
+			}
+		}
+		lod.m_namedSections = std::move(namedSections);
+		for (auto& proxy : lod.m_proxies) {
+			if (proxy.sectionIndex >= 0 && static_cast<size_t>(proxy.sectionIndex) < sections.size()) {
+				proxy.sectionIndex = sections[proxy.sectionIndex];
+			}
+		}
+	}
+
+	std::vector<LodShape> lods;
+	std::vector<LodType> lodDistances;
+	for (size_t i = 0u; i < shape.m_lods.size(); ++i) {
+		if (keep(i)) {
+			lods.push_back(std::move(shape.m_lods[i]));
+			lodDistances.push_back(shape.m_lodDistances[i]);
+		}
+	}
+	shape.m_lods = std::move(lods);
+	shape.m_lodDistances = std::move(lodDistances);
+	shape.m_lodCount = static_cast<uint32_t>(shape.m_lods.size());
+	shape.m_lodOffsets.clear();
+
+	for (int8_t Shape::*index : {&Shape::m_memoryLodIndex, &Shape::m_geometryLodIndex, &Shape::m_geometryFireLodIndex,
+		&Shape::m_geometryViewLodIndex, &Shape::m_geometryViewPilotLodIndex, &Shape::m_geometryViewGunnerLodIndex,
+		&Shape::m_geometryViewCommanderLodIndex, &Shape::m_geometryViewCargoLodIndex, &Shape::m_landContactLodIndex,
+		&Shape::m_roadwayLodIndex, &Shape::m_pathsLodIndex, &Shape::m_hitpointsLodIndex}) {
+		const int8_t value = shape.*index;
+		shape.*index = value >= 0 && static_cast<size_t>(value) < remap.size() ? remap[value] : int8_t(-1);
+	}
+	return true;
+}
+
+// ODOL arrays of an MLOD LOD. Every distinct point, normal and UV of a face corner becomes a vertex, the vertices
+// of a point are kept together in point order and a point without faces gets a vertex of its own. Positions are
+// stored relative to center. Faces are split into sections by texture and flags; selections are not sectional.
+std::optional<LodShape> BinarizeLodMLOD(const LodShapeMLOD& source, const Vector3F& center) {
+	LodShape lod{};
+	const auto& faces = source.faces;
+	const size_t pointCount = source.points.size();
+
+	// Corner keys: point, normal and UV bits, then the corner's place in the face list
+	using CornerKey = std::array<uint32_t, 7u>;
+	const auto bits = [](float value) {
+		uint32_t result;
+		std::memcpy(&result, &value, sizeof(result));
+		return result;
+	};
+	const auto cornerNormal = [&](size_t face, uint32_t k) -> const Vector3F& {
+		return source.normals[faces[face].table[k].normals_index];
+	};
+	std::vector<CornerKey> corners;
+	corners.reserve(4u * faces.size());
+	for (size_t i = 0u; i < faces.size(); ++i) {
+		const auto& face = faces[i];
+		if (face.type != 3 && face.type != 4) {
+			std::cout << "Invalid face with n " << face.type << std::endl;
+			return std::nullopt;
+		}
+		for (int32_t k = 0; k < face.type; ++k) {
+			const auto& corner = face.table[k];
+			if (corner.points_index < 0 || static_cast<size_t>(corner.points_index) >= pointCount ||
+				corner.normals_index < 0 || static_cast<size_t>(corner.normals_index) >= source.normals.size()) {
+				std::cout << "LOD " << FormatLodType(source.resolution) << ": face " << i << " points outside the LOD" << std::endl;
+				return std::nullopt;
+			}
+		}
+		for (int32_t k = 0; k < face.type; ++k) {
+			const auto& corner = face.table[k];
+			const auto& normal = cornerNormal(i, static_cast<uint32_t>(k));
+			corners.push_back({static_cast<uint32_t>(corner.points_index), bits(normal.X()), bits(normal.Y()), bits(normal.Z()),
+				bits(corner.u), bits(corner.v), static_cast<uint32_t>(4u * i + k)});
+		}
+	}
+	std::sort(corners.begin(), corners.end());
+
+	std::vector<uint16_t> cornerVertices(4u * faces.size(), 0u);
+	const auto addVertex = [&](uint32_t point, const Vector3F& normal, const Vector2& uv) {
+		lod.m_positions.push_back(source.points[point].pos - center);
+		lod.m_flags.push_back(convert_point_light_flags_to_odol(source.points[point].flags));
+		lod.m_normals.push_back(normal);
+		lod.m_uv.push_back(uv);
+		lod.m_vertexToPoints.push_back(static_cast<uint16_t>(point));
+		return static_cast<uint16_t>(lod.m_positions.size() - 1u);
+	};
+	for (size_t point = 0u, next = 0u; point < pointCount; ++point) {
+		lod.m_pointToVertices.push_back(static_cast<uint16_t>(lod.m_positions.size()));
+		if (next == corners.size() || corners[next][0] != point) {
+			addVertex(point, Vector3F(), Vector2());
+		}
+		while (next < corners.size() && corners[next][0] == point) {
+			const auto first = corners[next];
+			const auto& corner = faces[first[6] / 4u].table[first[6] % 4u];
+			const uint16_t vertex = addVertex(point, cornerNormal(first[6] / 4u, first[6] % 4u), Vector2(corner.u, corner.v));
+			for (; next < corners.size() && std::equal(first.begin(), first.begin() + 6, corners[next].begin()); ++next) {
+				cornerVertices[corners[next][6]] = vertex;
+			}
+		}
+	}
+	if (lod.m_positions.size() > 0xFFFFu) {
+		std::cout << "LOD " << FormatLodType(source.resolution) << ": " << lod.m_positions.size() << " vertices, ODOL holds up to 65535" << std::endl;
+		return std::nullopt;
+	}
+
+	// Faces, in MLOD corner order v1 v0 v2 / v1 v0 v3 v2; a quad folded onto itself is kept as a triangle
+	std::unordered_map<std::string, uint16_t> textures;
+	uint32_t offset = 0u;
+	for (size_t i = 0u; i < faces.size(); ++i) {
+		const auto& face = faces[i];
+		uint16_t textureIndex = 0xFFFFu;
+		if (!face.texture.empty()) {
+			const auto [texture, added] = textures.emplace(face.texture, static_cast<uint16_t>(lod.m_textureNames.size()));
+			if (added) {
+				lod.m_textureNames.push_back(face.texture);
+			}
+			textureIndex = texture->second;
+		}
+
+		const uint16_t* c = cornerVertices.data() + 4u * i;
+		const uint32_t flags = convert_face_flags_to_odol(face.flags);
+		if (face.type == 4 && c[1] != c[2]) {
+			lod.m_orignalFaces.emplace_back(flags, textureIndex, offset, c[1], c[0], c[3], c[2]);
+			offset += 2 + 4 * 2;
+		} else {
+			lod.m_orignalFaces.emplace_back(flags, textureIndex, offset, c[1], c[0], face.type == 4 ? c[3] : c[2]);
+			offset += 2 + 3 * 2;
+		}
+	}
+	lod.BuildFaceTable();
+
+	// Sections run over the face offsets
+	for (size_t begin = 0u; begin < lod.m_orignalFaces.size();) {
+		const auto& first = lod.m_orignalFaces[begin];
+		size_t end = begin + 1u;
+		while (end < lod.m_orignalFaces.size() && lod.m_orignalFaces[end].textureIndex == first.textureIndex &&
+			lod.m_orignalFaces[end].flags == first.flags) {
+			++end;
+		}
+		ShapeSection section;
+		section.startIndex = first.offset;
+		section.endIndex = end < lod.m_orignalFaces.size() ? lod.m_orignalFaces[end].offset : offset;
+		section.material = -1;
+		section.textureIndex = static_cast<int16_t>(first.textureIndex);
+		section.special = static_cast<int>(first.flags);
+		lod.m_sections.push_back(section);
+		begin = end;
+	}
+
+	// Selections take every vertex of their points, MLOD point weights are stored negated
+	size_t selectionIndex = 0u;
+	for (const auto& tag : source.tags) {
+		if (tag.empty() || tag[0] == '#' || selectionIndex >= source.named_selections.size()) {
+			continue;
+		}
+		const auto& selection = source.named_selections[selectionIndex++];
+		NamedSection section{};
+		section.name = tag;
+		std::transform(section.name.begin(), section.name.end(), section.name.begin(), ::tolower);
+		section.needSelection = false;
+
+		for (size_t i = 0u; i < selection.face.size() && i < faces.size(); ++i) {
+			if (selection.face[i] != 0u) {
+				section.faceIndices.push_back(static_cast<uint16_t>(i));
+			}
+		}
+		bool weighted = false;
+		for (size_t vertex = 0u; vertex < lod.m_vertexToPoints.size() && !selection.point.empty(); ++vertex) {
+			const uint8_t weight = selection.point[lod.m_vertexToPoints[vertex]];
+			if (weight != 0u) {
+				section.vertexIndices.push_back(static_cast<uint16_t>(vertex));
+				section.vertexWeights.push_back(static_cast<uint8_t>(-weight));
+				weighted |= weight != 0x01u;
+			}
+		}
+		if (!weighted) {
+			section.vertexWeights.clear();
+		}
+
+		// Proxy triangles have their origin between the two short edges, the longer one points forward
+		if (starts_with(section.name, "proxy:") && !section.faceIndices.empty()) {
+			const auto& face = lod.m_orignalFaces[section.faceIndices.front()];
+			std::array<Vector3F, 3u> p = {lod.m_positions[face.v0], lod.m_positions[face.v1], lod.m_positions[face.v2]};
+			const auto edge = [&](size_t a, size_t b) { return (p[b] - p[a]).Size2(); };
+			size_t origin = 0u;
+			if (edge(1u, 2u) < std::max(edge(0u, 1u), edge(0u, 2u))) {
+				origin = edge(0u, 1u) > edge(0u, 2u) ? 2u : 1u;
+			}
+			const size_t a = (origin + 1u) % 3u;
+			const size_t b = (origin + 2u) % 3u;
+			const size_t forward = edge(origin, a) > edge(origin, b) ? a : b;
+			const size_t up = forward == a ? b : a;
+
+			ProxyObject proxy;
+			const auto dot = section.name.rfind('.');
+			proxy.name = section.name.substr(6u, dot == std::string::npos || dot < 6u ? std::string::npos : dot - 6u);
+			proxy.id = dot == std::string::npos ? 0 : std::atoi(section.name.c_str() + dot + 1u);
+			proxy.transform = Matrix4F(p[forward] - p[origin], p[up] - p[origin], p[origin]);
+			proxy.sectionIndex = static_cast<int32_t>(lod.m_namedSections.size());
+			lod.m_proxies.push_back(std::move(proxy));
+		}
+		lod.m_namedSections.push_back(std::move(section));
+	}
+
+	for (size_t i = 0u; i + 1u < source.properties.size(); i += 2u) {
+		lod.m_namedProperties.push_back({source.properties[i], source.properties[i + 1u]});
+	}
+
+	// ODOL animation phases have a position for every vertex
+	for (const auto& frame : source.animations) {
+		AnimationPhase phase{frame.frame_time, {}};
+		if (frame.bone_pos.size() == pointCount) {
+			for (auto point : lod.m_vertexToPoints) {
+				phase.points.push_back(frame.bone_pos[point]);
+			}
+		} else {
+			phase.points = frame.bone_pos;
+		}
+		lod.m_animationPhases.push_back(std::move(phase));
+	}
+
+	// Bounds and clip hints
+	if (!lod.m_positions.empty()) {
+		lod.m_min = lod.m_max = lod.m_positions.front();
+		lod.m_hintsAnd = 0xFFFFFFFFu;
+	}
+	for (auto [position, flags] : fp::zip(lod.m_positions, lod.m_flags)) {
+		lod.m_min = Vector3F(std::min(lod.m_min.X(), position.X()), std::min(lod.m_min.Y(), position.Y()), std::min(lod.m_min.Z(), position.Z()));
+		lod.m_max = Vector3F(std::max(lod.m_max.X(), position.X()), std::max(lod.m_max.Y(), position.Y()), std::max(lod.m_max.Z(), position.Z()));
+		lod.m_hintsOr |= flags;
+		lod.m_hintsAnd &= flags;
+	}
+	lod.m_center = (lod.m_min + lod.m_max) * 0.5f;
+	for (const auto& position : lod.m_positions) {
+		lod.m_radius = std::max(lod.m_radius, (position - lod.m_center).Size());
+	}
+
+	lod.m_counts = {static_cast<uint32_t>(lod.m_flags.size()), static_cast<uint32_t>(lod.m_uv.size()),
+		static_cast<uint32_t>(lod.m_positions.size()), static_cast<uint32_t>(lod.m_normals.size()),
+		static_cast<uint32_t>(lod.m_pointToVertices.size()), static_cast<uint32_t>(lod.m_vertexToPoints.size()),
+		static_cast<uint32_t>(lod.m_orignalFaces.size())};
+	return lod;
+}
+
+// ODOL model of an MLOD one. Positions are moved by the center of the bounding box of all LODs unless the
+// geometry LOD has autocenter=0; mass, mass center and inertia come from the geometry LOD's point masses.
+std::optional<Shape> BinarizeMLOD(const ShapeMLOD& source) {
+	Shape shape{};
+	shape.m_version = 7u;
+	shape.m_density = 1.0f;
+	shape.m_canBeOccluded = true;
+
+	std::vector<const LodShapeMLOD*> lods;
+	for (const auto& lod : source.lods) {
+		if (lod.signature == signature_sp3x) {
+			lods.push_back(&lod);
+		}
+	}
+
+	// Special LODs are found by their resolution
+	const std::pair<uint32_t, int8_t Shape::*> specials[] = {
+		{0x58635fa9, &Shape::m_memoryLodIndex}, {0x551184e7, &Shape::m_geometryLodIndex},
+		{0x59c6f3b4, &Shape::m_geometryFireLodIndex}, {0x59aa87bf, &Shape::m_geometryViewLodIndex},
+		{0x5a38bdb9, &Shape::m_geometryViewPilotLodIndex}, {0x5a5529af, &Shape::m_geometryViewGunnerLodIndex},
+		{0x5a1c51c4, &Shape::m_geometryViewCommanderLodIndex}, {0x59e35fa9, &Shape::m_geometryViewCargoLodIndex},
+		{0x58e35fa9, &Shape::m_landContactLodIndex}, {0x592a87bf, &Shape::m_roadwayLodIndex},
+		{0x59635fa9, &Shape::m_pathsLodIndex}, {0x598e1bca, &Shape::m_hitpointsLodIndex}};
+	for (const auto& [resolution, index] : specials) {
+		shape.*index = -1;
+		for (size_t i = 0u; i < lods.size(); ++i) {
+			if (lods[i]->resolution.functional == resolution) {
+				shape.*index = static_cast<int8_t>(i);
+				break;
+			}
+		}
+	}
+	const LodShapeMLOD* geometry = shape.m_geometryLodIndex >= 0 ? lods[shape.m_geometryLodIndex] : nullptr;
+	const auto geometryProperty = [geometry](const char* name) -> const std::string* {
+		for (size_t i = 0u; geometry && i + 1u < geometry->properties.size(); i += 2u) {
+			if (strcasecmp(geometry->properties[i].c_str(), name) == 0) {
+				return &geometry->properties[i + 1u];
+			}
+		}
+		return nullptr;
+	};
+
+	// Center
+	bool anyPoint = false;
+	for (const auto* lod : lods) {
+		for (const auto& point : lod->points) {
+			shape.m_min = anyPoint ? Vector3F(std::min(shape.m_min.X(), point.pos.X()), std::min(shape.m_min.Y(), point.pos.Y()), std::min(shape.m_min.Z(), point.pos.Z())) : point.pos;
+			shape.m_max = anyPoint ? Vector3F(std::max(shape.m_max.X(), point.pos.X()), std::max(shape.m_max.Y(), point.pos.Y()), std::max(shape.m_max.Z(), point.pos.Z())) : point.pos;
+			anyPoint = true;
+		}
+	}
+	const std::string* autoCenter = geometryProperty("autocenter");
+	shape.m_autoCenter = !autoCenter || std::atoi(autoCenter->c_str()) != 0;
+	shape.m_lodCenter = shape.m_autoCenter ? (shape.m_min + shape.m_max) * 0.5f : Vector3F();
+	shape.m_min = shape.m_min - shape.m_lodCenter;
+	shape.m_max = shape.m_max - shape.m_lodCenter;
+
+	for (const auto* source_lod : lods) {
+		auto lod = BinarizeLodMLOD(*source_lod, shape.m_lodCenter);
+		if (!lod) {
+			return std::nullopt;
+		}
+		for (const auto& position : lod->m_positions) {
+			shape.m_lodSphere = std::max(shape.m_lodSphere, position.Size());
+		}
+		shape.m_hintsOr |= lod->m_hintsOr;
+		shape.m_hintsAnd = shape.m_lods.empty() ? lod->m_hintsAnd : shape.m_hintsAnd & lod->m_hintsAnd;
+		shape.m_lods.push_back(std::move(*lod));
+		shape.m_lodDistances.push_back(source_lod->resolution);
+	}
+	shape.m_lodCount = static_cast<uint32_t>(shape.m_lods.size());
+
+	// Mass
+	if (geometry) {
+		const auto& lod = shape.m_lods[shape.m_geometryLodIndex];
+		shape.m_physicsCenter = lod.m_center;
+		shape.m_physicsSphere = lod.m_radius;
+
+		if (geometry->mass.size() == geometry->points.size() && !geometry->mass.empty()) {
+			shape.m_masses = geometry->mass;
+			double mass = 0.0;
+			std::array<double, 3u> center = {};
+			for (size_t i = 0u; i < shape.m_masses.size(); ++i) {
+				const auto& position = lod.m_positions[lod.m_pointToVertices[i]];
+				mass += shape.m_masses[i];
+				center[0] += shape.m_masses[i] * position.X();
+				center[1] += shape.m_masses[i] * position.Y();
+				center[2] += shape.m_masses[i] * position.Z();
+			}
+
+			if (mass > 0.0) {
+				for (auto& axis : center) {
+					axis /= mass;
+				}
+				shape.m_mass = static_cast<float>(mass);
+				shape.m_invMass = static_cast<float>(1.0 / mass);
+				shape.m_massCenter = Vector3F(center[0], center[1], center[2]);
+
+				// Inertia tensor around the mass center, stored inverted
+				std::array<double, 9u> inertia = {};
+				for (size_t i = 0u; i < shape.m_masses.size(); ++i) {
+					const auto& position = lod.m_positions[lod.m_pointToVertices[i]];
+					const double r[3] = {position.X() - center[0], position.Y() - center[1], position.Z() - center[2]};
+					const double r2 = r[0] * r[0] + r[1] * r[1] + r[2] * r[2];
+					for (size_t row = 0u; row < 3u; ++row) {
+						for (size_t column = 0u; column < 3u; ++column) {
+							inertia[3u * row + column] += shape.m_masses[i] * ((row == column ? r2 : 0.0) - r[row] * r[column]);
+						}
+					}
+				}
+				const auto& m = inertia;
+				const double det = m[0] * (m[4] * m[8] - m[5] * m[7]) - m[1] * (m[3] * m[8] - m[5] * m[6]) + m[2] * (m[3] * m[7] - m[4] * m[6]);
+				std::array<float, 9u> inverse = {};
+				if (std::abs(det) > 1e-12) {
+					inverse = {
+						static_cast<float>((m[4] * m[8] - m[5] * m[7]) / det), static_cast<float>((m[2] * m[7] - m[1] * m[8]) / det), static_cast<float>((m[1] * m[5] - m[2] * m[4]) / det),
+						static_cast<float>((m[5] * m[6] - m[3] * m[8]) / det), static_cast<float>((m[0] * m[8] - m[2] * m[6]) / det), static_cast<float>((m[2] * m[3] - m[0] * m[5]) / det),
+						static_cast<float>((m[3] * m[7] - m[4] * m[6]) / det), static_cast<float>((m[1] * m[6] - m[0] * m[7]) / det), static_cast<float>((m[0] * m[4] - m[1] * m[3]) / det)};
+				}
+				shape.m_invInertia = Matrix3F(Vector3F(inverse[0], inverse[1], inverse[2]), Vector3F(inverse[3], inverse[4], inverse[5]),
+					Vector3F(inverse[6], inverse[7], inverse[8]));
+			}
+		}
+
+		if (const std::string* armor = geometryProperty("armor")) {
+			shape.m_armor = static_cast<float>(std::atof(armor->c_str()));
+			shape.m_invArmor = shape.m_armor > 0.0f ? 1.0f / shape.m_armor : 0.0f;
+		}
+	}
+
+	return shape;
+}
+
+// Union of the arrays needed by every requested output
+int FieldMaskFromOptions(int options) {
+	int fields = FIELD_NONE;
+	
+	if (options & OPTION_TEXTURE_LIST)
+		fields |= FIELD_LODS;
+	
+	if (options & OPTION_INFO_REPORT) {
+		fields |= FIELD_LODS | FIELD_MASSES;
+		
+		if (options & OPTION_INFO_FULL)
+			fields |= FIELD_POINTS | FIELD_VERTEX_MAP | FIELD_FACES | FIELD_ANIMATIONS;
+	}
+	
+	if (~options & OPTION_INFO || options & OPTION_CONVERT)
+		fields |= FIELD_LODS | FIELD_POINTS | FIELD_VERTEX_MAP | FIELD_FACES | FIELD_SELECTIONS | FIELD_ANIMATIONS | FIELD_MASSES;
+	
+	return fields;
+}
+
+// Diff ------------------------------------------------------------------------
+
+// One decoded array of a model or LOD as raw fixed size elements, so that arrays of both formats are
+// hashed and compared the same way
+struct ArrayDigest {
+	std::string name;
+	size_t elementSize;
+	std::vector<uint8_t> bytes;
+	uint64_t hash;
+};
+
+struct LodDigest {
+	LodType resolution;
+	std::vector<ArrayDigest> arrays;
+	uint64_t hash;
+};
+
+struct ModelDigest {
+	std::vector<ArrayDigest> arrays;
+	std::vector<LodDigest> lods;
+};
+
+uint64_t HashBytes(const uint8_t* data, size_t size, uint64_t seed = 0u) noexcept {
+	uint64_t h = (seed ^ size) * 0x9E3779B97F4A7C15ull;
+	size_t i = 0u;
+	for (; i + 8u <= size; i += 8u) {
+		uint64_t word;
+		std::memcpy(&word, data + i, sizeof(word));
+		h = (h ^ word) * 0xC2B2AE3D27D4EB4Full;
+		h ^= h >> 31;
+	}
+	uint64_t tail = 0u;
+	// Empty arrays hand in a null pointer, which memcpy must not see even for 0 bytes
+	if (size > i) {
+		std::memcpy(&tail, data + i, size - i);
+	}
+	h = (h ^ tail) * 0x165667B19E3779F9ull;
+	return h ^ (h >> 32);
+}
+
+uint64_t HashString(std::string_view text) noexcept {
+	return HashBytes(reinterpret_cast<const uint8_t*>(text.data()), text.size());
+}
+
+template <class T>
+void AppendBytes(std::vector<uint8_t>& bytes, const T& value) {
+	const auto* data = reinterpret_cast<const uint8_t*>(&value);
+	bytes.insert(bytes.end(), data, data + sizeof(T));
+}
+
+void AddArray(std::vector<ArrayDigest>& arrays, std::string name, size_t elementSize, std::vector<uint8_t> bytes) {
+	const uint64_t hash = HashBytes(bytes.data(), bytes.size(), elementSize);
+	arrays.push_back({std::move(name), elementSize, std::move(bytes), hash});
+}
+
+template <class T>
+void AddArray(std::vector<ArrayDigest>& arrays, std::string name, const std::vector<T>& values) {
+	const auto* data = reinterpret_cast<const uint8_t*>(values.data());
+	AddArray(arrays, std::move(name), sizeof(T), std::vector<uint8_t>(data, data + values.size() * sizeof(T)));
+}
+
+void FinishLodDigest(LodDigest& lod) {
+	lod.hash = 0u;
+	for (const auto& array : lod.arrays) {
+		lod.hash = HashBytes(reinterpret_cast<const uint8_t*>(&array.hash), sizeof(array.hash), lod.hash ^ HashString(array.name));
+	}
+}
+
+ModelDigest DigestModel(const Shape& shape) {
+	ModelDigest model;
+	AddArray(model.arrays, "resolutions", shape.m_lodDistances);
+	AddArray(model.arrays, "masses", shape.m_masses);
+
+	std::vector<uint8_t> header;
+	for (auto value : {shape.m_properties, shape.m_properties2, shape.m_hintsAnd, shape.m_hintsOr}) {
+		AppendBytes(header, value);
+	}
+	for (auto value : {shape.m_lodSphere, shape.m_physicsSphere, shape.m_density, shape.m_mass, shape.m_armor}) {
+		AppendBytes(header, value);
+	}
+	for (const auto& value : {shape.m_aimPoint, shape.m_min, shape.m_max, shape.m_lodCenter, shape.m_physicsCenter, shape.m_massCenter}) {
+		AppendBytes(header, value);
+	}
+	for (auto value : {shape.m_color, shape.m_color2}) {
+		AppendBytes(header, value);
+	}
+	for (auto value : {shape.m_autoCenter, shape.m_autoCenter2, shape.m_canOcclude, shape.m_canBeOccluded, shape.m_allowAnimation}) {
+		AppendBytes(header, static_cast<uint8_t>(value));
+	}
+	for (auto value : {shape.m_mapType, static_cast<uint8_t>(shape.m_memoryLodIndex), static_cast<uint8_t>(shape.m_geometryLodIndex),
+		static_cast<uint8_t>(shape.m_geometryFireLodIndex), static_cast<uint8_t>(shape.m_geometryViewLodIndex),
+		static_cast<uint8_t>(shape.m_geometryViewPilotLodIndex), static_cast<uint8_t>(shape.m_geometryViewGunnerLodIndex),
+		static_cast<uint8_t>(shape.m_geometryViewCommanderLodIndex), static_cast<uint8_t>(shape.m_geometryViewCargoLodIndex),
+		static_cast<uint8_t>(shape.m_landContactLodIndex), static_cast<uint8_t>(shape.m_roadwayLodIndex),
+		static_cast<uint8_t>(shape.m_pathsLodIndex), static_cast<uint8_t>(shape.m_hitpointsLodIndex)}) {
+		AppendBytes(header, value);
+	}
+	const size_t headerSize = header.size();
+	AddArray(model.arrays, "properties", headerSize, std::move(header));
+
+	for (auto [source, resolution] : fp::zip(shape.GetLods(), shape.GetLodDistances())) {
+		LodDigest lod;
+		lod.resolution = resolution;
+		auto& arrays = lod.arrays;
+		AddArray(arrays, "positions", source.m_positions);
+		AddArray(arrays, "normals", source.m_normals);
+		AddArray(arrays, "uvs", source.m_uv);
+		AddArray(arrays, "point flags", source.m_flags);
+		AddArray(arrays, "point to vertices", source.m_pointToVertices);
+		AddArray(arrays, "vertex to points", source.m_vertexToPoints);
+
+		std::vector<uint8_t> faces;
+		for (const auto& face : source.m_orignalFaces) {
+			for (uint32_t value : {face.flags, face.textureIndex, uint32_t{face.v0}, uint32_t{face.v1}, uint32_t{face.v2},
+				face.IsQuad() ? uint32_t{face.v3} : 0xFFFFFFFFu}) {
+				AppendBytes(faces, value);
+			}
+		}
+		AddArray(arrays, "faces", 6u * sizeof(uint32_t), std::move(faces));
+
+		std::vector<uint64_t> textures;
+		for (const auto& name : source.m_textureNames) {
+			textures.push_back(HashString(name));
+		}
+		AddArray(arrays, "textures", textures);
+
+		std::vector<uint8_t> sections;
+		for (const auto& section : source.m_sections) {
+			for (uint32_t value : {section.startIndex, section.endIndex, static_cast<uint32_t>(section.material),
+				static_cast<uint32_t>(section.textureIndex), static_cast<uint32_t>(section.special)}) {
+				AppendBytes(sections, value);
+			}
+		}
+		AddArray(arrays, "sections", 5u * sizeof(uint32_t), std::move(sections));
+
+		for (const auto& sec : source.m_namedSections) {
+			const std::string name = "selection \"" + sec.name + "\" ";
+			AddArray(arrays, name + "faces", sec.faceIndices);
+			AddArray(arrays, name + "face weights", sec.faceWeights);
+			AddArray(arrays, name + "vertices", sec.vertexIndices);
+			AddArray(arrays, name + "vertex weights", sec.vertexWeights);
+		}
+
+		std::vector<uint64_t> properties;
+		for (const auto& prop : source.m_namedProperties) {
+			properties.push_back(HashString(prop.name + "=" + prop.value));
+		}
+		AddArray(arrays, "named properties", properties);
+
+		std::vector<float> times;
+		for (size_t i = 0u; i < source.m_animationPhases.size(); ++i) {
+			times.push_back(source.m_animationPhases[i].time);
+			AddArray(arrays, "animation " + std::to_string(i), source.m_animationPhases[i].points);
+		}
+		AddArray(arrays, "animation times", times);
+
+		std::vector<uint8_t> proxies;
+		for (const auto& proxy : source.m_proxies) {
+			AppendBytes(proxies, HashString(proxy.name));
+			AppendBytes(proxies, proxy.transform);
+			AppendBytes(proxies, proxy.id);
+			AppendBytes(proxies, proxy.sectionIndex);
+		}
+		AddArray(arrays, "proxies", sizeof(uint64_t) + sizeof(Matrix4F) + 2u * sizeof(int32_t), std::move(proxies));
+
+		std::vector<uint8_t> bounds;
+		for (const auto& value : {source.m_center, source.m_min, source.m_max}) {
+			AppendBytes(bounds, value);
+		}
+		AppendBytes(bounds, source.m_radius);
+		for (auto value : {source.m_hintsAnd, source.m_hintsOr, source.m_flags2}) {
+			AppendBytes(bounds, value);
+		}
+		for (auto value : {source.m_color, source.m_color2}) {
+			AppendBytes(bounds, value);
+		}
+		const size_t boundsSize = bounds.size();
+		AddArray(arrays, "bounds", boundsSize, std::move(bounds));
+
+		FinishLodDigest(lod);
+		model.lods.push_back(std::move(lod));
+	}
+
+	return model;
+}
+
+ModelDigest DigestModel(const ShapeMLOD& shape) {
+	ModelDigest model;
+	std::vector<LodType> resolutions;
+	for (const auto& source : shape.lods) {
+		resolutions.push_back(source.resolution);
+	}
+	AddArray(model.arrays, "resolutions", resolutions);
+	AddArray(model.arrays, "default path", std::vector<uint64_t>{HashString(shape.SP3X_DefaultPath)});
+
+	for (const auto& source : shape.lods) {
+		LodDigest lod;
+		lod.resolution = source.resolution;
+		auto& arrays = lod.arrays;
+		AddArray(arrays, "points", source.points);
+		AddArray(arrays, "normals", source.normals);
+
+		std::vector<uint8_t> faces;
+		for (const auto& face : source.faces) {
+			std::array<char, 32u> texture = {};
+			std::copy_n(face.texture.begin(), std::min(face.texture.size(), texture.size()), texture.begin());
+			AppendBytes(faces, texture);
+			AppendBytes(faces, face.type);
+			for (const auto& vertex : face.table) {
+				AppendBytes(faces, vertex);
+			}
+			AppendBytes(faces, face.flags);
+		}
+		AddArray(arrays, "faces", 32u + 2u * sizeof(int32_t) + 4u * sizeof(VertexTableMLOD), std::move(faces));
+
+		AddArray(arrays, "sharp edges", source.sharp_edges);
+		AddArray(arrays, "mass", source.mass);
+
+		std::vector<uint64_t> properties;
+		for (size_t i = 0u; i + 1u < source.properties.size(); i += 2u) {
+			properties.push_back(HashString(source.properties[i] + "=" + source.properties[i + 1u]));
+		}
+		AddArray(arrays, "named properties", properties);
+
+		std::vector<float> times;
+		for (size_t i = 0u; i < source.animations.size(); ++i) {
+			times.push_back(source.animations[i].frame_time);
+			AddArray(arrays, "animation " + std::to_string(i), source.animations[i].bone_pos);
+		}
+		AddArray(arrays, "animation times", times);
+
+		// Named selections are the tags whose name does not start with #, in the same order
+		size_t selection = 0u;
+		for (const auto& tag : source.tags) {
+			if (!tag.empty() && tag[0] != '#' && selection < source.named_selections.size()) {
+				const auto& sec = source.named_selections[selection++];
+				AddArray(arrays, "selection \"" + tag + "\" points", sec.point);
+				AddArray(arrays, "selection \"" + tag + "\" faces", sec.face);
+			}
+		}
+
+		FinishLodDigest(lod);
+		model.lods.push_back(std::move(lod));
+	}
+
+	return model;
+}
+
+// Reads a model as ODOL or MLOD. With asMLOD an ODOL model is converted first, so that it can be
+// compared against an MLOD one.
+std::optional<ModelDigest> ReadModelDigest(const std::string& path, bool asMLOD, int options) {
+	fp::file file(path, "rb");
+	if (!file.is_open()) {
+		std::cout << "Failed to open " << path << " - error " << errno << ": " << strerror(errno) << std::endl;
+		return std::nullopt;
+	}
+
+	uint32_t signature = 0u;
+	ReadValue(signature, file);
+	if (signature == signature_mlod) {
+		return DigestModel(ShapeMLOD(file));
+	}
+	if (signature != signature_odol) {
+		std::cout << "Incorrect file type " << FormatSignature(signature) << " in " << path << std::endl;
+		return std::nullopt;
+	}
+
+	const Shape shape(file, FIELD_ALL);
+	if (!asMLOD) {
+		return DigestModel(shape);
+	}
+
+	const auto converted = fs::temp_directory_path() / ("odol2mlod_diff_" + std::to_string(getpid()) + ".p3d");
+	{
+		fp::file out(converted.string(), "wb");
+		if (!out.is_open()) {
+			std::cout << "Failed to create file " << converted.string() << " - error " << errno << ": " << strerror(errno) << std::endl;
+			return std::nullopt;
+		}
+		WriteMLOD(out, shape, options);
+	}
+	fp::file in(converted.string(), "rb");
+	ReadValue(signature, in);
+	ModelDigest model = DigestModel(ShapeMLOD(in));
+	in.close();
+	fs::remove(converted);
+	return model;
+}
+
+uint32_t ReadSignature(const std::vector<uint8_t>& bytes) {
+	uint32_t signature = 0u;
+	if (!bytes.empty()) {
+		std::memcpy(&signature, bytes.data(), std::min(bytes.size(), sizeof(signature)));
+	}
+	return signature;
+}
+
+// Describes how two arrays of the same name differ, comparing elements only when their hashes do
+void DiffArrays(std::ostream& out, const ArrayDigest& a, const ArrayDigest& b) {
+	if (a.hash == b.hash && a.bytes == b.bytes) {
+		return;
+	}
+	out << "\t\t" << a.name << ": ";
+	if (a.elementSize != b.elementSize) {
+		out << "element size " << a.elementSize << " / " << b.elementSize << std::endl;
+		return;
+	}
+
+	const size_t countA = a.bytes.size() / a.elementSize, countB = b.bytes.size() / b.elementSize;
+	const size_t common = std::min(countA, countB);
+	size_t differing = 0u, first = common;
+	for (size_t i = 0u; i < common; ++i) {
+		if (std::memcmp(a.bytes.data() + i * a.elementSize, b.bytes.data() + i * b.elementSize, a.elementSize) != 0) {
+			first = std::min(first, i);
+			++differing;
+		}
+	}
+
+	if (countA != countB) {
+		out << countA << " / " << countB << " elements, ";
+	}
+	out << differing << " of " << common << (countA != countB ? " common" : "") << " elements differ";
+	if (differing > 0u) {
+		out << ", first at " << first;
+	}
+	out << std::endl;
+}
+
+// Arrays only one side has, and the ones both have that differ
+void DiffArrayLists(std::ostream& out, const std::vector<ArrayDigest>& a, const std::vector<ArrayDigest>& b) {
+	std::unordered_map<std::string_view, const ArrayDigest*> byName;
+	for (const auto& array : b) {
+		byName.emplace(array.name, &array);
+	}
+	for (const auto& array : a) {
+		const auto other = byName.find(array.name);
+		if (other == byName.end()) {
+			out << "\t\t" << array.name << ": only in the first" << std::endl;
+		} else {
+			DiffArrays(out, array, *other->second);
+			byName.erase(other);
+		}
+	}
+	for (const auto& array : b) {
+		if (byName.count(array.name)) {
+			out << "\t\t" << array.name << ": only in the second" << std::endl;
+		}
+	}
+}
+
+// Hash of everything a model decodes to, independent of how its arrays were compressed
+uint64_t HashModel(const ModelDigest& model) {
+	uint64_t hash = 0u;
+	const auto add = [&](uint64_t value) {
+		hash = HashBytes(reinterpret_cast<const uint8_t*>(&value), sizeof(value), hash);
+	};
+	for (const auto& array : model.arrays) {
+		add(HashString(array.name));
+		add(array.hash);
+	}
+	for (const auto& lod : model.lods) {
+		add(lod.resolution.functional);
+		add(lod.hash);
+	}
+	return hash;
+}
+
+// Whether two digests hold the same arrays and LODs, compared as the diff compares them
+bool SameModel(const ModelDigest& a, const ModelDigest& b) {
+	if (a.lods.size() != b.lods.size()) {
+		return false;
+	}
+	std::ostringstream differences;
+	DiffArrayLists(differences, a.arrays, b.arrays);
+	for (size_t i = 0u; i < a.lods.size(); ++i) {
+		if (a.lods[i].resolution.functional != b.lods[i].resolution.functional) {
+			return false;
+		}
+		DiffArrayLists(differences, a.lods[i].arrays, b.lods[i].arrays);
+	}
+	return differences.str().empty();
+}
+
+// Adds a model to the group of models with its content, returns the first model of the group when
+// there was one already. Models with the same hash are read again and compared before they are grouped.
+std::optional<std::string> RecordModel(const std::string& path, const ModelDigest& model, int options) {
+	auto& groups = global.model_groups[HashModel(model)];
+	for (const size_t group : groups) {
+		auto& files = global.model_group_files[group];
+		const auto first = ReadModelDigest(files.front(), false, options);
+		if (first && SameModel(*first, model)) {
+			files.push_back(path);
+			return files.front();
+		}
+	}
+	groups.push_back(global.model_group_files.size());
+	global.model_group_files.push_back({path});
+	return std::nullopt;
+}
+
+// Makes output a hard link to the output of the first model with the same content, or a copy of it where
+// links are not possible
+void LinkDuplicateOutput(const std::string& first, const std::string& output) {
+	std::error_code error;
+	fs::remove(output, error);
+	fs::create_hard_link(first, output, error);
+	if (error) {
+		fs::copy_file(first, output, fs::copy_options::overwrite_existing, error);
+	}
+	if (error) {
+		std::cout << "Failed to link " << output << " to " << first << " - " << error.message() << std::endl;
+	}
+}
+
+// Reports the differences between two models, LODs are paired by resolution. Returns 0 when they are
+// the same, 1 when they differ and 2 when one of them can not be read.
+int DiffFiles(const std::string& pathA, const std::string& pathB, int options) {
+	std::vector<uint8_t> bytesA, bytesB;
+	{
+		fp::file a(pathA, "rb"), b(pathB, "rb");
+		a.read_all(bytesA);
+		b.read_all(bytesB);
+	}
+	if (bytesA == bytesB && !bytesA.empty()) {
+		return 0;
+	}
+
+	// Compressed ODOL arrays can not be compared with MLOD ones, so a mixed pair is compared as MLOD
+	const bool mixed = ReadSignature(bytesA) != ReadSignature(bytesB);
+	bytesA = {};
+	bytesB = {};
+	const auto a = ReadModelDigest(pathA, mixed, options);
+	const auto b = ReadModelDigest(pathB, mixed, options);
+	if (!a || !b) {
+		return 2;
+	}
+
+	std::ostringstream report;
+	{
+		std::ostringstream header;
+		DiffArrayLists(header, a->arrays, b->arrays);
+		if (!header.str().empty()) {
+			report << "\tModel" << std::endl << header.str();
+		}
+	}
+
+	std::vector<uint8_t> paired(b->lods.size(), 0u);
+	for (const auto& lodA : a->lods) {
+		size_t match = b->lods.size();
+		for (size_t j = 0u; j < b->lods.size() && match == b->lods.size(); ++j) {
+			if (!paired[j] && b->lods[j].resolution.functional == lodA.resolution.functional) {
+				match = j;
+			}
+		}
+		if (match == b->lods.size()) {
+			report << "\tLOD " << FormatLodType(lodA.resolution) << " only in the first" << std::endl;
+			continue;
+		}
+		paired[match] = 1u;
+		if (lodA.hash != b->lods[match].hash) {
+			std::ostringstream arrays;
+			DiffArrayLists(arrays, lodA.arrays, b->lods[match].arrays);
+			if (!arrays.str().empty()) {
+				report << "\tLOD " << FormatLodType(lodA.resolution) << std::endl << arrays.str();
+			}
+		}
+	}
+	for (size_t j = 0u; j < b->lods.size(); ++j) {
+		if (!paired[j]) {
+			report << "\tLOD " << FormatLodType(b->lods[j].resolution) << " only in the second" << std::endl;
+		}
+	}
+
+	if (report.str().empty()) {
+		return 0;
+	}
+	std::cout << pathA << " / " << pathB << (mixed ? " (ODOL converted to MLOD)" : "") << std::endl << report.str();
+	return 1;
+}
+
+// Pairs the models of two directories by relative path, counting every pair and reporting the ones
+// that differ or exist on one side only
+int DiffDirectories(const fs::path& dirA, const fs::path& dirB, int options) {
+	const auto listModels = [&](const fs::path& dir) {
+		std::vector<std::string> models;
+		const auto add = [&](const fs::directory_entry& entry) {
+			if (entry.is_regular_file() && entry.path().extension() == ".p3d") {
+				models.push_back(fs::relative(entry.path(), dir).generic_string());
+			}
+		};
+		if (options & OPTION_RECURSIVE) {
+			for (const auto& entry : fs::recursive_directory_iterator(dir)) {
+				add(entry);
+			}
+		} else {
+			for (const auto& entry : fs::directory_iterator(dir)) {
+				add(entry);
+			}
+		}
+		std::sort(models.begin(), models.end());
+		return models;
+	};
+
+	try {
+		const auto modelsA = listModels(dirA);
+		const auto modelsB = listModels(dirB);
+		size_t differing = 0u;
+		auto b = modelsB.begin();
+		for (const auto& model : modelsA) {
+			for (; b != modelsB.end() && *b < model; ++b) {
+				std::cout << (dirB / *b).string() << " only in the second" << std::endl;
+				++differing;
+			}
+			if (b != modelsB.end() && *b == model) {
+				differing += DiffFiles((dirA / model).string(), (dirB / *b).string(), options) != 0 ? 1u : 0u;
+				++b;
+			} else {
+				std::cout << (dirA / model).string() << " only in the first" << std::endl;
+				++differing;
+			}
+		}
+		for (; b != modelsB.end(); ++b) {
+			std::cout << (dirB / *b).string() << " only in the second" << std::endl;
+			++differing;
+		}
+		std::cout << "Models differing: " << differing << std::endl;
+		return differing > 0u ? 1 : 0;
+	} catch (const std::exception& e) {
+		std::cout << "Error scanning directory: " << e.what() << std::endl;
+		return 2;
+	}
+}
+
+// One kind of problem that --lint found, lod is -1 for the ones of the whole model
+struct LintProblem {
+	int lod;
+	std::string resolution;
+	const char* check;
+	size_t count;       // offending values
+	size_t first;       // first offending face, vertex, point or selection element
+	std::string detail; // selection name, signature or error number
+};
+
+// Looks for the indices and values in the decoded arrays that would crash the conversion or produce garbage,
+// the range checks run through the kernels and the first offending element is only searched for once they fail
+std::vector<LintProblem> LintShape(const Shape& shape) {
+	std::vector<LintProblem> problems;
+	const auto firstOutOfRange = [](const auto& values, uint32_t limit) -> size_t {
+		return std::find_if(values.begin(), values.end(), [limit](auto value) { return value >= limit; }) - values.begin();
+	};
+
+	for (size_t lodIndex = 0u; lodIndex < shape.GetLods().size(); ++lodIndex) {
+		const auto& lod = shape.GetLods()[lodIndex];
+		const LodType resolution = shape.GetLodDistances()[lodIndex];
+		const auto report = [&](const char* check, size_t count, size_t first, std::string detail = std::string()) {
+			if (count > 0u) {
+				problems.push_back({static_cast<int>(lodIndex), FormatLodType(resolution), check, count, first, std::move(detail)});
+			}
+		};
+
+		const auto& positions = lod.GetPositions();
+		const auto& faces = lod.GetOriginalFaces();
+		const auto vertexCount = static_cast<uint32_t>(positions.size());
+		const auto pointCount = static_cast<uint32_t>(lod.GetPointToVertices().size());
+
+		// Per vertex arrays that end before the positions, a LOD may have no vertex to point table at all
+		{
+			const auto& vertexToPoints = lod.GetVertexToPoints();
+			size_t shortArrays = 0u;
+			size_t firstMissing = vertexCount;
+			for (const size_t size : {lod.GetFlags().size(), lod.GetUvs().size(), lod.GetNormals().size(),
+				vertexToPoints.empty() ? positions.size() : vertexToPoints.size()}) {
+				if (size < vertexCount) {
+					++shortArrays;
+					firstMissing = std::min(firstMissing, size);
+				}
+			}
+			report("vertex_arrays", shortArrays, firstMissing);
+		}
+
+		// Every triangle ends with NO_CORNER, which is above any limit
+		{
+			const auto& corners = lod.GetFaceTable().corners;
+			const size_t triangles = std::count_if(faces.begin(), faces.end(), [](const Face& face) { return !face.IsQuad(); });
+			const size_t bad = kernels.count_out_of_range_u32(corners.data(), corners.size(), vertexCount) - triangles;
+			if (bad > 0u) {
+				const auto corner = std::find_if(corners.begin(), corners.end(), [vertexCount](uint32_t index) {
+					return index >= vertexCount && index != FaceTable::NO_CORNER;
+				});
+				report("face_index", bad, (corner - corners.begin()) / 4u);
+			}
+		}
+
+		// 0xFFFF marks an untextured face
+		{
+			size_t bad = 0u;
+			size_t first = 0u;
+			for (size_t i = 0u; i < faces.size(); ++i) {
+				if (faces[i].textureIndex >= lod.GetTextureNames().size() && faces[i].textureIndex != 0xFFFFu && bad++ == 0u) {
+					first = i;
+				}
+			}
+			report("texture_index", bad, first);
+		}
+
+		// Faces repeating a vertex or covering no area, shadow volumes are built out of such faces on purpose
+		if (resolution.graphical < 10000.0f || resolution.graphical >= 20000.0f) {
+			const auto flat = [&](uint16_t a, uint16_t b, uint16_t c) {
+				const Vector3F edge1 = positions[b] - positions[a];
+				const Vector3F edge2 = positions[c] - positions[a];
+				return edge1.Cross(edge2).Size2() <= 1e-12f * edge1.Size2() * edge2.Size2();
+			};
+			size_t bad = 0u;
+			size_t first = 0u;
+			for (size_t i = 0u; i < faces.size(); ++i) {
+				const auto& face = faces[i];
+				if (std::max({face.v0, face.v1, face.v2, face.v3}) >= vertexCount) {
+					continue;
+				}
+				const bool repeated = face.v0 == face.v1 || face.v1 == face.v2 || face.v2 == face.v0
+					|| (face.IsQuad() && (face.v3 == face.v1 || face.v3 == face.v2));
+				const bool degenerate = repeated || (flat(face.v0, face.v1, face.v2) && (!face.IsQuad() || flat(face.v0, face.v2, face.v3)));
+				if (degenerate && bad++ == 0u) {
+					first = i;
+				}
+			}
+			report("degenerate_face", bad, first);
+		}
+
+		{
+			const auto values = reinterpret_cast<const float*>(positions.data());
+			const size_t bad = kernels.count_non_finite(values, 3u * positions.size());
+			if (bad > 0u) {
+				report("nan_position", bad, (std::find_if(values, values + 3u * positions.size(), [](float value) {
+					return !std::isfinite(value);
+				}) - values) / 3u);
+			}
+		}
+
+		if (const auto& vertexToPoints = lod.GetVertexToPoints(); !vertexToPoints.empty()) {
+			const size_t bad = kernels.count_out_of_range_u16(vertexToPoints.data(), vertexToPoints.size(), pointCount);
+			report("vertex_to_point", bad, bad > 0u ? firstOutOfRange(vertexToPoints, pointCount) : 0u);
+		}
+
+		{
+			const auto& pointToVertices = lod.GetPointToVertices();
+			const size_t bad = kernels.count_out_of_range_u16(pointToVertices.data(), pointToVertices.size(), vertexCount);
+			report("point_to_vertex", bad, bad > 0u ? firstOutOfRange(pointToVertices, vertexCount) : 0u);
+		}
+
+		const auto faceCount = static_cast<uint32_t>(faces.size());
+		for (const auto& section : lod.GetNamedSections()) {
+			const size_t badFaces = kernels.count_out_of_range_u16(section.faceIndices.data(), section.faceIndices.size(), faceCount);
+			report("section_face", badFaces, badFaces > 0u ? firstOutOfRange(section.faceIndices, faceCount) : 0u, section.name);
+
+			const size_t badVertices = kernels.count_out_of_range_u16(section.vertexIndices.data(), section.vertexIndices.size(), vertexCount);
+			report("section_vertex", badVertices, badVertices > 0u ? firstOutOfRange(section.vertexIndices, vertexCount) : 0u, section.name);
+		}
+	}
+
+	// Masses are given either per vertex or per point of the geometry LOD
+	const int geometry = shape.GetGeometryLodIndex();
+	if (!shape.GetMasses().empty() && geometry >= 0 && geometry < static_cast<int>(shape.GetLods().size())) {
+		const auto& lod = shape.GetLods()[geometry];
+		const size_t masses = shape.GetMasses().size();
+		if (masses != lod.GetPositions().size() && masses < lod.GetPointToVertices().size()) {
+			problems.push_back({geometry, FormatLodType(shape.GetLodDistances()[geometry]), "masses",
+				lod.GetPointToVertices().size() - masses, masses, std::string()});
+		}
+	}
+
+	return problems;
+}
+
+int Parse_P3D(std::string filename_input, std::string file_info, int &options) {
+	std::cout << filename_input << std::endl;
+	fp::file file(filename_input, "rb");
+	
+	if (!file.is_open()) {
+		std::cout << "Failed to open - error " << errno << ": " << strerror(errno) << std::endl;
+		return 1;
+	}
+	
+	// Verify file type
+	uint32_t current_file_signature;
+	ReadValue(current_file_signature, file);
+	
+	if (current_file_signature!=signature_odol  &&  current_file_signature!=signature_mlod) {
+		file.close();
+		std::cout << "Incorrect file type " << FormatSignature(current_file_signature) << std::endl;
+		return 2;
+	}
+	
+	// Create output
+	std::fstream out;
+	std::ios_base::openmode mode = std::ios::out | std::ios::trunc;
+	std::string filename_output  = "";
+	std::string filename_mlod    = CreateOutPath(filename_input);
+	std::string filename_odol    = CreateOutPath(filename_input, "_odol.p3d");
+	std::string filename_server  = CreateOutPath(filename_input, "_server.p3d");
+	const bool binarize          = options & OPTION_BINARIZE;
+	const bool server            = options & OPTION_SERVER;
+	
+	if (options & OPTION_INFO) {
+		if (options & (OPTION_INFO_REPORT | OPTION_PROBE) || ~options & OPTION_TEXTURE_LIST_SINGLE) {
 			filename_output = CreateOutPath(filename_input, ".txt");
 			
 			if (options & (OPTION_SINGLELOG)) {
@@ -1028,11 +5296,9 @@ int Parse_P3D(std::string filename_input, std::string file_info, int &options) {
 				}
 			}
 		}
-	} else
-		if (current_file_signature == signature_odol)
-			filename_output = CreateOutPath(filename_input);
+	}
 
-	if (!filename_output.empty() && ~options & OPTION_TEXTURE_LIST_SINGLE) {
+	if (!filename_output.empty()) {
 		out.open(filename_output.c_str(), mode);
 		
 		if (!out.is_open()) {
@@ -1042,422 +5308,310 @@ int Parse_P3D(std::string filename_input, std::string file_info, int &options) {
 	}
 	
 	global.files_ok++;
-	
-	if (options & (OPTION_SINGLELOG) && ~options & OPTION_TEXTURE_LIST_SINGLE && ~mode & std::ios::trunc)
-		out << std::endl << std::endl << "====================================" << std::endl << std::endl;
-	
-	// Parse input
-	if (current_file_signature == signature_odol) {
-		Shape shape(file);
-		
-		if (options & OPTION_INFO) {
-			if (options & OPTION_TEXTURE_LIST) {
-				if (~options & OPTION_TEXTURE_LIST_SINGLE) {
-					out << filename_input << std::endl << std::endl;
-					global.texture_list.clear();
-				}
-				bool output_lod_name = false;
-				
-				for (unsigned int i=0; i<shape.m_lods.size(); i++) {
-					LodShape *l = &shape.m_lods[i];
-					
-					if (options & OPTION_TEXTURE_LIST_LODS) {
-						output_lod_name = true;
-						global.texture_list.clear();
-					}
-					
-					for (unsigned int j=0; j<l->m_textureNames.size(); j++) {
-						bool already_added = false;
-						
-						if (l->m_textureNames[j].empty()) 
-							continue;
-						
-						for (size_t k=0; k<global.texture_list.size() && !already_added; k++)
-							if (strcasecmp(global.texture_list[k].c_str(),l->m_textureNames[j].c_str()) == 0)
-								already_added = true;
-					
-						if (!already_added) {
-							if (output_lod_name) {
-								output_lod_name = false;
-								out << "LOD: " << FormatLodType(shape.m_lodDistances[i]) << std::endl;
-							}
-							
-							if (~options & OPTION_TEXTURE_LIST_SINGLE)
-								out << (options & OPTION_TEXTURE_LIST_LODS ? "\t" : "") << l->m_textureNames[j] << std::endl;
-							
-							global.texture_list.push_back(l->m_textureNames[j]);
-						}
-					}
-				}
-			} else {
+	
+	if (options & (OPTION_SINGLELOG) && ~mode & std::ios::trunc && (options & OPTION_INFO_REPORT || (options & OPTION_TEXTURE_LIST && ~options & OPTION_TEXTURE_LIST_SINGLE)))
+		out << std::endl << std::endl << "====================================" << std::endl << std::endl;
+	
+	// Parse input
+	if (current_file_signature == signature_odol) {
+		// Conversion alone is streamed LOD by LOD, reports need every LOD in memory
+		// Deduplication hashes every decoded array and verification compares the written LODs, so neither streams
+		const bool dedupe  = options & OPTION_DEDUPE;
+		const bool verify  = options & OPTION_VERIFY;
+		// With -b an ODOL model is only copied, so nothing of it is decoded unless a report needs it
+		// With -S it is rewritten as a whole instead of converted, so every array is decoded
+		const bool write   = (~options & OPTION_INFO || options & OPTION_CONVERT) && ~options & OPTION_DEDUPE_REPORT;
+		const bool convert = write && !binarize && !server;
+		const bool stream  = convert && !dedupe && !verify && ~options & OPTION_INFO_REPORT && ~options & OPTION_TEXTURE_LIST;
+		const bool skip    = stream || (binarize && !server && ~options & OPTION_INFO);
+		// A streamed conversion walks over the LODs but still writes the masses into the geometry LOD
+		const int  fields  = stream ? FIELD_MASSES : skip ? FIELD_NONE : dedupe || (server && write) ? FIELD_ALL : FieldMaskFromOptions(options);
+		Shape shape(file, fields);
+		
+		if (options & OPTION_PROBE) {
+			out << 
+			filename_input << "\t" << 
+			FormatSignature(current_file_signature) << "\t" << 
+			shape.m_version << "\t" << 
+			shape.m_lodCount << "\t";
+			
+			for (size_t i=0; i<shape.m_lodDistances.size(); i++)
+				out << (i>0 ? "," : "") << FormatLodType(shape.m_lodDistances[i]);
+			
+			out << "\t" << 
+			(int)shape.m_memoryLodIndex << "," << 
+			(int)shape.m_geometryLodIndex << "," << 
+			(int)shape.m_geometryFireLodIndex << "," << 
+			(int)shape.m_geometryViewLodIndex << "," << 
+			(int)shape.m_geometryViewPilotLodIndex << "," << 
+			(int)shape.m_geometryViewGunnerLodIndex << "," << 
+			(int)shape.m_geometryViewCommanderLodIndex << "," << 
+			(int)shape.m_geometryViewCargoLodIndex << "," << 
+			(int)shape.m_landContactLodIndex << "," << 
+			(int)shape.m_roadwayLodIndex << "," << 
+			(int)shape.m_pathsLodIndex << "," << 
+			(int)shape.m_hitpointsLodIndex << "\t" << 
+			shape.m_mass << "\t" << 
+			shape.m_armor << std::endl;
+		}
+		
+		if (options & OPTION_INFO_REPORT) {
+			out << 
+			filename_input << " - " << file_info << std::endl << std::endl <<
+			"Signature: "<< FormatSignature(current_file_signature) << std::endl << 
+			"Version: " << shape.m_version << std::endl <<
+			"Number of LODs: " << shape.m_lodCount << std::endl << 
+			"Flags: " << std::hex << "0x" << shape.m_properties << std::endl;
+			
+			for (unsigned int i=1; options & OPTION_INFO_FULL && i<0x80000000; i*=2)
+				if (shape.m_properties & i) 
+					out << "\t 0x" << i << std::endl;
+			
+			out << std::dec <<
+			"Bounding sphere radius: " << shape.m_lodSphere << std::endl << 
+			"Bounding geometry sphere radius: " << shape.m_physicsSphere << std::endl << 
+			"Remarks: " << shape.m_properties2 << std::endl << 
+			"Hints and: " << shape.m_hintsAnd << std::endl << 
+			"Hints or: " << shape.m_hintsOr << std::endl << 
+			"Aim point x:" << shape.m_aimPoint.X() << " y:" << shape.m_aimPoint.Y() << " z:" << shape.m_aimPoint.Z() << std::endl << 
+			"Color:" << (int)shape.m_color.r << " g:" << (int)shape.m_color.g << " b:" << (int)shape.m_color.b << " a:" << (int)shape.m_color.a << std::endl << 
+			"Color top r:" << (int)shape.m_color2.r << " g:" << (int)shape.m_color2.g << " b:" << (int)shape.m_color2.b << " a:" << (int)shape.m_color2.a << std::endl << 
+			"View density: " << shape.m_density << std::endl << 
+			"Bounding sphere min x:" << shape.m_min.X() << " y:" << shape.m_min.Y() << " z:" << shape.m_min.Z() << std::endl << 
+			"Bounding sphere max x:" << shape.m_max.X() << " y:" << shape.m_max.Y() << " z:" << shape.m_max.Z() << std::endl << 
+			"Bounding sphere center x:" << shape.m_lodCenter.X() << " y:" << shape.m_lodCenter.Y() << " z:" << shape.m_lodCenter.Z() << std::endl << 
+			"Bounding geometry sphere center x:" << shape.m_physicsCenter.X() << " y:" << shape.m_physicsCenter.Y() << " z:" << shape.m_physicsCenter.Z() << std::endl << 
+			"Mass center x:" << shape.m_massCenter.X() << " y:" << shape.m_massCenter.Y() << " z:" << shape.m_massCenter.Z() << std::endl << 
+			"Inverse inertia tensor a:" << shape.m_invInertia.Aside().Size() << " u:" << shape.m_invInertia.Up().Size() << " d:" << shape.m_invInertia.Direction().Size() << std::endl << 
+			"Auto center: " << shape.m_autoCenter << std::endl << 
+			"Lock auto center: " << shape.m_autoCenter2 << std::endl << 
+			"Can occlude: " << shape.m_canOcclude << std::endl << 
+			"Can be occluded: " << shape.m_canBeOccluded << std::endl << 
+			"Allow animation: " << shape.m_allowAnimation << std::endl << 
+			"Map type: " << (int)shape.m_mapType << std::endl << 
+			"Mass array count: " << shape.m_masses.size() << std::endl;
+			
+			for (size_t j=0; j<shape.m_masses.size() && options & OPTION_INFO_FULL; j++)
+				out << "\t" << j << " - " << shape.m_masses[j] << std::endl;
+				
+			out << 
+			"Mass: " << shape.m_mass << std::endl << 
+			"Mass inverse: " << shape.m_invMass << std::endl << 
+			"Armor: " << shape.m_armor << std::endl << 
+			"Armor inverse: " << shape.m_invArmor << std::endl << 
+			"Memory LOD index: " << (int)shape.m_memoryLodIndex << std::endl << 
+			"Geometry LOD index: " << (int)shape.m_geometryLodIndex << std::endl << 
+			"Fire geometry LOD index: " << (int)shape.m_geometryFireLodIndex << std::endl << 
+			"View geometry LOD index: " << (int)shape.m_geometryViewLodIndex << std::endl << 
+			"View pilot geometry LOD index: " << (int)shape.m_geometryViewPilotLodIndex << std::endl << 
+			"View gunner geometry LOD index: " << (int)shape.m_geometryViewGunnerLodIndex << std::endl << 
+			"View command geometry LOD index: " << (int)shape.m_geometryViewCommanderLodIndex << std::endl << 
+			"View cargo geometry LOD index: " << (int)shape.m_geometryViewCargoLodIndex << std::endl << 
+			"Land contact LOD index: " << (int)shape.m_landContactLodIndex << std::endl << 
+			"Roadway LOD index: " << (int)shape.m_roadwayLodIndex << std::endl << 
+			"Paths LOD index: " << (int)shape.m_pathsLodIndex << std::endl << 
+			"Hitpoints LOD index: " << (int)shape.m_hitpointsLodIndex;
+			
+			for (size_t i=0; i<shape.m_lods.size(); i++) {
+				LodShape *l = &shape.m_lods[i];
+				
+				out << std::endl << std::endl << 
+				"LOD: " << FormatLodType(shape.m_lodDistances[i]) << std::endl <<
+				"Flags count: " << l->m_counts.flags << std::endl;
+				
+				for (size_t j=0; j<l->m_flags.size() && options & OPTION_INFO_FULL; j++)
+					out << "\t" << j << " - 0x" << std::hex << l->m_flags[j] << std::dec << std::endl;
+
 				out << 
-				filename_input << " - " << file_info << std::endl << std::endl <<
-				"Signature: "<< FormatSignature(current_file_signature) << std::endl << 
-				"Version: " << shape.m_version << std::endl <<
-				"Number of LODs: " << shape.m_lodCount << std::endl << 
-				"Flags: " << std::hex << "0x" << shape.m_properties << std::endl;
+				"UV: " << l->m_counts.uv << std::endl;
 				
-				for (unsigned int i=1; options & OPTION_INFO_FULL && i<0x80000000; i*=2)
-					if (shape.m_properties & i) 
-						out << "\t 0x" << i << std::endl;
+				for (size_t j=0; j<l->m_uv.size() && options & OPTION_INFO_FULL; j++)
+					out << "\t" << j << " - u:" << l->m_uv[j].X() << " v:" << l->m_uv[j].Y() << std::endl;
 				
-				out << std::dec <<
-				"Bounding sphere radius: " << shape.m_lodSphere << std::endl << 
-				"Bounding geometry sphere radius: " << shape.m_physicsSphere << std::endl << 
-				"Remarks: " << shape.m_properties2 << std::endl << 
-				"Hints and: " << shape.m_hintsAnd << std::endl << 
-				"Hints or: " << shape.m_hintsOr << std::endl << 
-				"Aim point x:" << shape.m_aimPoint.X() << " y:" << shape.m_aimPoint.Y() << " z:" << shape.m_aimPoint.Z() << std::endl << 
-				"Color:" << (int)shape.m_color.r << " g:" << (int)shape.m_color.g << " b:" << (int)shape.m_color.b << " a:" << (int)shape.m_color.a << std::endl << 
-				"Color top r:" << (int)shape.m_color2.r << " g:" << (int)shape.m_color2.g << " b:" << (int)shape.m_color2.b << " a:" << (int)shape.m_color2.a << std::endl << 
-				"View density: " << shape.m_density << std::endl << 
-				"Bounding sphere min x:" << shape.m_min.X() << " y:" << shape.m_min.Y() << " z:" << shape.m_min.Z() << std::endl << 
-				"Bounding sphere max x:" << shape.m_max.X() << " y:" << shape.m_max.Y() << " z:" << shape.m_max.Z() << std::endl << 
-				"Bounding sphere center x:" << shape.m_lodCenter.X() << " y:" << shape.m_lodCenter.Y() << " z:" << shape.m_lodCenter.Z() << std::endl << 
-				"Bounding geometry sphere center x:" << shape.m_physicsCenter.X() << " y:" << shape.m_physicsCenter.Y() << " z:" << shape.m_physicsCenter.Z() << std::endl << 
-				"Mass center x:" << shape.m_massCenter.X() << " y:" << shape.m_massCenter.Y() << " z:" << shape.m_massCenter.Z() << std::endl << 
-				"Inverse inertia tensor a:" << shape.m_invInertia.Aside().Size() << " u:" << shape.m_invInertia.Up().Size() << " d:" << shape.m_invInertia.Direction().Size() << std::endl << 
-				"Auto center: " << shape.m_autoCenter << std::endl << 
-				"Lock auto center: " << shape.m_autoCenter2 << std::endl << 
-				"Can occlude: " << shape.m_canOcclude << std::endl << 
-				"Can be occluded: " << shape.m_canBeOccluded << std::endl << 
-				"Allow animation: " << shape.m_allowAnimation << std::endl << 
-				"Map type: " << (int)shape.m_mapType << std::endl << 
-				"Mass array count: " << shape.m_masses.size() << std::endl;
+				out <<
+				"Points: " << l->m_counts.positions << std::endl;
 				
-				for (size_t j=0; j<shape.m_masses.size() && options & OPTION_INFO_FULL; j++)
-					out << "\t" << j << " - " << shape.m_masses[j] << std::endl;
+				for (size_t j=0; j<l->m_positions.size() && options & OPTION_INFO_FULL; j++)
+					out << "\t" << j << " - x:" << l->m_positions[j].X() << " y:" << l->m_positions[j].Y() << " z:" << l->m_positions[j].Z() << std::endl;
 					
 				out << 
-				"Mass: " << shape.m_mass << std::endl << 
-				"Mass inverse: " << shape.m_invMass << std::endl << 
-				"Armor: " << shape.m_armor << std::endl << 
-				"Armor inverse: " << shape.m_invArmor << std::endl << 
-				"Memory LOD index: " << (int)shape.m_memoryLodIndex << std::endl << 
-				"Geometry LOD index: " << (int)shape.m_geometryLodIndex << std::endl << 
-				"Fire geometry LOD index: " << (int)shape.m_geometryFireLodIndex << std::endl << 
-				"View geometry LOD index: " << (int)shape.m_geometryViewLodIndex << std::endl << 
-				"View pilot geometry LOD index: " << (int)shape.m_geometryViewPilotLodIndex << std::endl << 
-				"View gunner geometry LOD index: " << (int)shape.m_geometryViewGunnerLodIndex << std::endl << 
-				"View command geometry LOD index: " << (int)shape.m_geometryViewCommanderLodIndex << std::endl << 
-				"View cargo geometry LOD index: " << (int)shape.m_geometryViewCargoLodIndex << std::endl << 
-				"Land contact LOD index: " << (int)shape.m_landContactLodIndex << std::endl << 
-				"Roadway LOD index: " << (int)shape.m_roadwayLodIndex << std::endl << 
-				"Paths LOD index: " << (int)shape.m_pathsLodIndex << std::endl << 
-				"Hitpoints LOD index: " << (int)shape.m_hitpointsLodIndex;
+				"Normals: " << l->m_counts.normals << std::endl;
 				
-				for (size_t i=0; i<shape.m_lods.size(); i++) {
-					LodShape *l = &shape.m_lods[i];
-					
-					out << std::endl << std::endl << 
-					"LOD: " << FormatLodType(shape.m_lodDistances[i]) << std::endl <<
-					"Flags count: " << l->m_flags.size() << std::endl;
-					
-					for (size_t j=0; j<l->m_flags.size() && options & OPTION_INFO_FULL; j++)
-						out << "\t" << j << " - 0x" << std::hex << l->m_flags[j] << std::dec << std::endl;
-
-					out << 
-					"UV: " << l->m_uv.size() << std::endl;
-					
-					for (size_t j=0; j<l->m_uv.size() && options & OPTION_INFO_FULL; j++)
-						out << "\t" << j << " - u:" << l->m_uv[j].X() << " v:" << l->m_uv[j].Y() << std::endl;
-					
-					out <<
-					"Points: " << l->m_positions.size() << std::endl;
-					
-					for (size_t j=0; j<l->m_positions.size() && options & OPTION_INFO_FULL; j++)
-						out << "\t" << j << " - x:" << l->m_positions[j].X() << " y:" << l->m_positions[j].Y() << " z:" << l->m_positions[j].Z() << std::endl;
-						
-					out << 
-					"Normals: " << l->m_normals.size() << std::endl;
-					
-					for (size_t j=0; j<l->m_normals.size() && options & OPTION_INFO_FULL; j++)
-						out << "\t" << j << " - x:" << l->m_normals[j].X() << " y:" << l->m_normals[j].Y() << " z:" << l->m_normals[j].Z() << std::endl;
-						
-					out << 
-					"Hints or: " << l->m_hintsOr << std::endl	<< 
-					"Hints and: " << l->m_hintsAnd << std::endl << 
-					"Min pos x:" << l->m_min.X() << " y:" << l->m_min.Y() << " z:" << l->m_min.Z() << std::endl << 
-					"Max pos x:" << l->m_max.X() << " y:" << l->m_max.Y() << " z:" << l->m_max.Z() << std::endl << 
-					"Center pos x:" << l->m_center.X() << " y:" << l->m_center.Y() << " z:" << l->m_center.Z() << std::endl << 
-					"Radius: " << l->m_radius << std::endl << 
-					"Textures: " << l->m_textureNames.size() << std::endl;
-					
-					for (size_t j=0; j<l->m_textureNames.size(); j++)
-						out << "\t" << l->m_textureNames[j] << std::endl;
-					
-					out << 
-					"Point to vertice index: " << l->m_pointToVertices.size() << std::endl;
+				for (size_t j=0; j<l->m_normals.size() && options & OPTION_INFO_FULL; j++)
+					out << "\t" << j << " - x:" << l->m_normals[j].X() << " y:" << l->m_normals[j].Y() << " z:" << l->m_normals[j].Z() << std::endl;
 					
-						for (size_t j=0; j<l->m_pointToVertices.size() && options & OPTION_INFO_FULL; j++)
-							out << "\t" << j << " " << l->m_pointToVertices[j] << std::endl;
-					
-					out << "Vertice to point index: " << l->m_vertexToPoints.size() << std::endl;
+				out << 
+				"Hints or: " << l->m_hintsOr << std::endl	<< 
+				"Hints and: " << l->m_hintsAnd << std::endl << 
+				"Min pos x:" << l->m_min.X() << " y:" << l->m_min.Y() << " z:" << l->m_min.Z() << std::endl << 
+				"Max pos x:" << l->m_max.X() << " y:" << l->m_max.Y() << " z:" << l->m_max.Z() << std::endl << 
+				"Center pos x:" << l->m_center.X() << " y:" << l->m_center.Y() << " z:" << l->m_center.Z() << std::endl << 
+				"Radius: " << l->m_radius << std::endl << 
+				"Textures: " << l->m_textureNames.size() << std::endl;
+				
+				for (size_t j=0; j<l->m_textureNames.size(); j++)
+					out << "\t" << l->m_textureNames[j] << std::endl;
+				
+				out << 
+				"Point to vertice index: " << l->m_counts.pointToVertices << std::endl;
+				
+					for (size_t j=0; j<l->m_pointToVertices.size() && options & OPTION_INFO_FULL; j++)
+						out << "\t" << j << " " << l->m_pointToVertices[j] << std::endl;
+				
+				out << "Vertice to point index: " << l->m_counts.vertexToPoints << std::endl;
 
-						for (size_t j=0; j<l->m_vertexToPoints.size() && options & OPTION_INFO_FULL; j++)
-							out << "\t" << j << " " << l->m_vertexToPoints[j] << std::endl;				
-					
-					out << "Faces: " << l->m_orignalFaces.size() << std::endl;
-					
-					for (size_t j=0; j<l->m_orignalFaces.size() && options & OPTION_INFO_FULL; j++)
-						out << "\t" << j << " - flags:0x" << std::hex << l->m_orignalFaces[j].flags << std::dec << std::endl;
-						
-					out << 
-					"Sections: " << l->m_sections.size() << std::endl;
+					for (size_t j=0; j<l->m_vertexToPoints.size() && options & OPTION_INFO_FULL; j++)
+						out << "\t" << j << " " << l->m_vertexToPoints[j] << std::endl;				
+				
+				out << "Faces: " << l->m_counts.faces << std::endl;
+				
+				for (size_t j=0; j<l->m_orignalFaces.size() && options & OPTION_INFO_FULL; j++)
+					out << "\t" << j << " - flags:0x" << std::hex << l->m_orignalFaces[j].flags << std::dec << std::endl;
 					
-					for (size_t j=0; j<l->m_sections.size() && options & OPTION_INFO_FULL; j++)
-						out << "\t" << j << " - startIndex:" << l->m_sections[j].startIndex << " endIndex:" << l->m_sections[j].endIndex << " material:" << l->m_sections[j].material << " textureIndex:" << l->m_sections[j].textureIndex << " special:0x" << std::hex << l->m_sections[j].special << std::dec << std::endl;
-		
-					out << 
-					"Named sections: " << l->m_namedSections.size() << std::endl;
+				out << 
+				"Sections: " << l->m_sections.size() << std::endl;
+				
+				for (size_t j=0; j<l->m_sections.size() && options & OPTION_INFO_FULL; j++)
+					out << "\t" << j << " - startIndex:" << l->m_sections[j].startIndex << " endIndex:" << l->m_sections[j].endIndex << " material:" << l->m_sections[j].material << " textureIndex:" << l->m_sections[j].textureIndex << " special:0x" << std::hex << l->m_sections[j].special << std::dec << std::endl;
+	
+				out << 
+				"Named sections: " << l->m_namedSections.size() << std::endl;
+				
+				for (size_t j=0; j<l->m_namedSections.size(); j++)
+					out << "\t" << l->m_namedSections[j].name << std::endl;
 					
-					for (size_t j=0; j<l->m_namedSections.size(); j++)
-						out << "\t" << l->m_namedSections[j].name << std::endl;
-						
-					out << "Properties: " << l->m_namedProperties.size()  << std::endl;
+				out << "Properties: " << l->m_namedProperties.size()  << std::endl;
+				
+				for (size_t j=0; j<l->m_namedProperties.size(); j++)
+					out << "\t" << l->m_namedProperties[j].name << "=" << l->m_namedProperties[j].value << std::endl;
 					
-					for (size_t j=0; j<l->m_namedProperties.size(); j++)
-						out << "\t" << l->m_namedProperties[j].name << "=" << l->m_namedProperties[j].value << std::endl;
-						
-					out << 
-					"Animation frames: " << l->m_animationPhases.size() << std::endl;
+				out << 
+				"Animation frames: " << l->m_animationPhases.size() << std::endl;
+				
+				for (size_t j=0; j<l->m_animationPhases.size() && options & OPTION_INFO_FULL; j++) {
+					out << "\t" << j << " - Time:" << l->m_animationPhases[j].time << std::endl;
 					
-					for (size_t j=0; j<l->m_animationPhases.size() && options & OPTION_INFO_FULL; j++) {
-						out << "\t" << j << " - Time:" << l->m_animationPhases[j].time << std::endl;
-						
-						for (size_t k=0; k<l->m_animationPhases[j].points.size(); k++) {
-							out << "\t\t"
-							" x:" << l->m_animationPhases[j].points[k].X() << 
-							" y:" << l->m_animationPhases[j].points[k].Y() << 
-							" z:" << l->m_animationPhases[j].points[k].Z() << 
-							std::endl;
-						}
+					for (size_t k=0; k<l->m_animationPhases[j].points.size(); k++) {
+						out << "\t\t"
+						" x:" << l->m_animationPhases[j].points[k].X() << 
+						" y:" << l->m_animationPhases[j].points[k].Y() << 
+						" z:" << l->m_animationPhases[j].points[k].Z() << 
+						std::endl;
 					}
+				}
 
-					out << 
-					"Color top r:" << (int)l->m_color.r << " g:" << (int)l->m_color.g << " b:" << (int)l->m_color.b << " a:" << (int)l->m_color.a << std::endl << 
-					"Color r:" << (int)l->m_color2.r << " g:" << (int)l->m_color2.g << " b:" << (int)l->m_color2.b << " a:" << (int)l->m_color2.a << std::endl << 
-					"Flags: " << std::hex << "0x" << (int)l->m_flags2 << std::endl;
+				out << 
+				"Color top r:" << (int)l->m_color.r << " g:" << (int)l->m_color.g << " b:" << (int)l->m_color.b << " a:" << (int)l->m_color.a << std::endl << 
+				"Color r:" << (int)l->m_color2.r << " g:" << (int)l->m_color2.g << " b:" << (int)l->m_color2.b << " a:" << (int)l->m_color2.a << std::endl << 
+				"Flags: " << std::hex << "0x" << (int)l->m_flags2 << std::endl;
 
-					for (unsigned int j=1; options & OPTION_INFO_FULL && j<0x80000000; j*=2)
-						if (l->m_flags2 & j) 
-							out << "\t 0x" << j << std::endl;
-						
-					out << std::dec <<
-					"Proxies: " << l->m_proxies.size();
+				for (unsigned int j=1; options & OPTION_INFO_FULL && j<0x80000000; j*=2)
+					if (l->m_flags2 & j) 
+						out << "\t 0x" << j << std::endl;
 					
-					for (size_t j=0; j<l->m_proxies.size(); j++)
-						out << std::endl << "\t" << l->m_proxies[j].name;
-				}
+				out << std::dec <<
+				"Proxies: " << l->m_proxies.size();
+				
+				for (size_t j=0; j<l->m_proxies.size(); j++)
+					out << std::endl << "\t" << l->m_proxies[j].name;
+			}
+		}
+		
+		if (options & OPTION_TEXTURE_LIST) {
+			if (options & OPTION_INFO_REPORT && ~options & OPTION_TEXTURE_LIST_SINGLE)
+				out << std::endl << std::endl;
+			
+			if (~options & OPTION_TEXTURE_LIST_SINGLE) {
+				out << filename_input << std::endl << std::endl;
+				global.texture_list.clear();
 			}
-		} 
-		else {
-			fp::file out(filename_output.c_str(), "wb");
-			global.files_to_skip.push_back(filename_output);
+			bool output_lod_name = false;
 			
-			// P3DHeader
-			constexpr static uint32_t mlodVersion = 0x0101;
-			out.write(fp::to_bytes(signature_mlod));
-			out.write(fp::to_bytes(mlodVersion));
-			out.write(fp::to_bytes(static_cast<uint32_t>(shape.GetLods().size())));
-
-			for (auto [lod, lodDistance, lodIndex] : fp::zip_index(shape.GetLods(), shape.GetLodDistances())) {
-				uint32_t normalCount = 0u;
-				for (const auto& face : lod.GetOriginalFaces()) {
-					if (face.IsQuad()) {
-						normalCount += 4u;
-					} else {
-						normalCount += 3u;
-					}
-				}
-
-				bool merge_this_lod = options & OPTION_MERGE_POINTS || (options & OPTION_MERGE_POINTS_SELECTIVE && lodDistance.graphical>=1000.0f);
+			for (unsigned int i=0; i<shape.m_lods.size(); i++) {
+				LodShape *l = &shape.m_lods[i];
 				
-				// MLOD_LOD
-				out.write(fp::to_bytes(signature_sp3x));
-				out.write(fp::to_bytes(static_cast<uint32_t>(0x1c)));
-				out.write(fp::to_bytes(static_cast<uint32_t>(0x99)));
-				uint16_t positonsCount = merge_this_lod ? lod.GetPointToVertices().size() : lod.GetPositions().size();
-				out.write(fp::to_bytes(static_cast<uint32_t>(positonsCount)));
-				out.write(fp::to_bytes(normalCount));
-				out.write(fp::to_bytes(static_cast<uint32_t>(lod.GetOriginalFaces().size())));
-				out.write(fp::to_bytes(static_cast<uint32_t>(0x00)));
-
-				// Points
-				if (merge_this_lod) {
-					for (auto index : lod.GetPointToVertices()) {
-						const auto& vertex = lod.GetPositions()[index];
-						const auto& flags_odol = lod.GetFlags()[index];
-						out.write(fp::to_bytes(vertex + shape.GetLodCenter()));
-						out.write(fp::to_bytes(convert_point_light_flags(flags_odol, options & OPTION_ONLY_USER_VALUE)));
-					}
-				} else {
-					for (auto [vertex, flags_odol] : fp::zip(lod.GetPositions(), lod.GetFlags())) {
-						out.write(fp::to_bytes(vertex + shape.GetLodCenter()));
-						out.write(fp::to_bytes(convert_point_light_flags(flags_odol, options & OPTION_ONLY_USER_VALUE)));
-					}
-				}
-
-				// Normals
-				for (const auto& face : lod.GetOriginalFaces()) {
-					out.write(fp::to_bytes(lod.GetNormals()[face.v0]));
-					out.write(fp::to_bytes(lod.GetNormals()[face.v1]));
-					out.write(fp::to_bytes(lod.GetNormals()[face.v2]));
-					if (face.IsQuad()) {
-						out.write(fp::to_bytes(lod.GetNormals()[face.v3]));
-					}
+				if (options & OPTION_TEXTURE_LIST_LODS) {
+					output_lod_name = true;
+					global.texture_list.clear();
 				}
-
-				// Faces
-				uint32_t normalIndex = 0u;
-				for (const auto& face : lod.GetOriginalFaces()) {
-					std::array<char, 32u> texture;
-					texture.fill('\0');
-					if (face.textureIndex < lod.GetTextureNames().size()) {
-						fp::span_copy(lod.GetTextureNames()[face.textureIndex], texture);
-						texture.back() = '\0';
-					}
-					out.write(texture);
-
-					out.write(fp::to_bytes(static_cast<uint32_t>(face.IsQuad() ? 4u : 3u)));
-					std::array<FaceVertex, 4u> vertices;
-					if (face.IsQuad()) {
-						vertices[0].vertexIndex = merge_this_lod ? lod.VertexToPoint(face.v1) : face.v1;
-						vertices[0].normalIndex = normalIndex;
-						vertices[0].uv = lod.GetUvs()[face.v1];
-						++normalIndex;
-						vertices[1].vertexIndex = merge_this_lod ? lod.VertexToPoint(face.v0) : face.v0;
-						vertices[1].normalIndex = normalIndex;
-						vertices[1].uv = lod.GetUvs()[face.v0];
-						++normalIndex;
-						vertices[2].vertexIndex = merge_this_lod ? lod.VertexToPoint(face.v3) : face.v3;
-						vertices[2].normalIndex = normalIndex;
-						vertices[2].uv = lod.GetUvs()[face.v3];
-						++normalIndex;
-						vertices[3].vertexIndex = merge_this_lod ? lod.VertexToPoint(face.v2) : face.v2;
-						vertices[3].normalIndex = normalIndex;
-						vertices[3].uv = lod.GetUvs()[face.v2];
-						++normalIndex;
-					} else {
-						vertices[0].vertexIndex = merge_this_lod ? lod.VertexToPoint(face.v1) : face.v1;
-						vertices[0].normalIndex = normalIndex;
-						vertices[0].uv = lod.GetUvs()[face.v1];
-						++normalIndex;
-						vertices[1].vertexIndex = merge_this_lod ? lod.VertexToPoint(face.v0) : face.v0;
-						vertices[1].normalIndex = normalIndex;
-						vertices[1].uv = lod.GetUvs()[face.v0];
-						++normalIndex;
-						vertices[2].vertexIndex = merge_this_lod ? lod.VertexToPoint(face.v2) : face.v2;
-						vertices[2].normalIndex = normalIndex;
-						vertices[2].uv = lod.GetUvs()[face.v2];
-						++normalIndex;
-					}
-					out.write(vertices);
+				
+				for (unsigned int j=0; j<l->m_textureNames.size(); j++) {
+					bool already_added = false;
 					
-
-					// Flags
-					uint32_t flags_mlod = 0u;
+					if (l->m_textureNames[j].empty()) 
+						continue;
 					
-					if ((face.flags & 0x40) != 0u) flags_mlod|=0x8;	//?
-					if ((face.flags & 0x20) != 0u) flags_mlod|=0x10; //shadow off
-
-					if ((face.flags & 0x4000000) != 0u) flags_mlod|=0x100;//zbias low
-					if ((face.flags & 0x8000000) != 0u) flags_mlod|=0x200;//zbias middle
-					if ((face.flags & 0xC000000) != 0u) flags_mlod|=0x300;//zbias high
-					if ((face.flags & 0x20000000) != 0u) flags_mlod|=0x1000000;//texture merging off
-					out.write(fp::to_bytes(flags_mlod));
-				}
-
-				out.write(fp::to_bytes(signature_tagg));
-
-				// Named sections
-				{
-					const auto namedSectionSize = static_cast<uint32_t>(positonsCount + lod.GetOriginalFaces().size());
-					std::vector<uint8_t> sectionWeights;
-					sectionWeights.resize(positonsCount);
-					std::vector<uint8_t> isFaceInSection;
-					isFaceInSection.resize(lod.GetOriginalFaces().size());
-
-					for (const auto& sec : lod.GetNamedSections()) {
-						WriteName<64>(out, sec.name);
-						out.write(fp::to_bytes(namedSectionSize));
-
-						std::fill(sectionWeights.begin(), sectionWeights.end(), 0u);
-						if (sec.vertexWeights.empty()) {
-							for (auto index : sec.vertexIndices) {
-								sectionWeights[merge_this_lod ? lod.VertexToPoint(index) : index] = 0x01;
-							}
-						} else {
-							for (auto [weight, index] : fp::zip(sec.vertexWeights, sec.vertexIndices)) {								
-								sectionWeights[merge_this_lod ? lod.VertexToPoint(index) : index] = -weight; // why
-							}
+					for (size_t k=0; k<global.texture_list.size() && !already_added; k++)
+						if (strcasecmp(global.texture_list[k].c_str(),l->m_textureNames[j].c_str()) == 0)
+							already_added = true;
+				
+					if (!already_added) {
+						if (output_lod_name) {
+							output_lod_name = false;
+							out << "LOD: " << FormatLodType(shape.m_lodDistances[i]) << std::endl;
 						}
 						
-						std::fill(isFaceInSection.begin(), isFaceInSection.end(), 0u);
-						for (auto faceIndex : sec.faceIndices) {
-							isFaceInSection[faceIndex] = 1u;
-						}
+						if (~options & OPTION_TEXTURE_LIST_SINGLE)
+							out << (options & OPTION_TEXTURE_LIST_LODS ? "\t" : "") << l->m_textureNames[j] << std::endl;
 						
-						out.write(sectionWeights);
-						out.write(isFaceInSection);
-					}
-				}
-
-				// Properties
-				for (const auto& prop : lod.GetNamedProperties()) {
-					WriteName<64>(out, "#Property#");
-					out.write(fp::to_bytes(static_cast<uint32_t>(128)));
-					WriteName<64>(out, prop.name);
-					WriteName<64>(out, prop.value);
-				}
-
-				// Mass
-				if ((int)lodIndex == shape.GetGeometryLodIndex() && !shape.GetMasses().empty()) {
-					WriteName<64>(out, "#Mass#");
-					
-					if (merge_this_lod) {
-						out.write(fp::to_bytes(static_cast<uint32_t>(4u * shape.GetMasses().size())));
-						out.write(shape.GetMasses());
-					} else {
-						if (shape.GetMasses().size() == lod.GetPositions().size()) {
-							out.write(fp::to_bytes(static_cast<uint32_t>(4u * shape.GetMasses().size())));
-							out.write(shape.GetMasses());
-						} else {
-							std::vector<float> pointVertexCounts(lod.m_pointToVertices.size(), 0.0f);
-							for (auto pointIndex: lod.m_vertexToPoints) {
-								pointVertexCounts[pointIndex] += 1.0f;
-							}
-							std::vector<float> newMasses;
-							newMasses.reserve(lod.m_positions.size());
-							for (size_t vertexIndex = 0u;vertexIndex < lod.m_positions.size();++vertexIndex) {
-								const auto pointIndex  = lod.m_vertexToPoints[vertexIndex];
-								const auto vextexCount = pointVertexCounts[pointIndex];
-								newMasses.push_back(shape.GetMasses()[pointIndex] / vextexCount);
-							}
-							out.write(fp::to_bytes(static_cast<uint32_t>(4u * newMasses.size())));
-							out.write(newMasses);
-						}
+						global.texture_list.push_back(l->m_textureNames[j]);
 					}
 				}
-				
-				// Animations
-				for (size_t j=0; j<lod.m_animationPhases.size(); j++) {
-					WriteName<64>(out, "#Animation#");
-					uint32_t tagg_size = sizeof(lod.m_animationPhases[j].time) + 3u * lod.m_animationPhases[j].points.size() * sizeof(float);
-					out.write(fp::to_bytes(static_cast<uint32_t>(tagg_size)));
-					out.write(fp::to_bytes(lod.m_animationPhases[j].time));
-					
-					for (size_t k=0; k<lod.m_animationPhases[j].points.size(); k++) {
-						out.write(fp::to_bytes(lod.m_animationPhases[j].points[k].X()));
-						out.write(fp::to_bytes(lod.m_animationPhases[j].points[k].Y()));
-						out.write(fp::to_bytes(lod.m_animationPhases[j].points[k].Z()));
-					}
+			}
+		}
+		
+		std::optional<std::string> duplicate_of;
+		if (dedupe)
+			duplicate_of = RecordModel(filename_input, DigestModel(shape), options);
+		
+		if (convert && duplicate_of) {
+			global.files_to_skip.push_back(filename_mlod);
+			LinkDuplicateOutput(CreateOutPath(*duplicate_of), filename_mlod);
+		} else if (convert) {
+			// Verified before the output is opened, so a model that fails leaves an earlier output untouched
+			std::optional<std::vector<char>> verified;
+			if (verify) {
+				verified = WriteVerifiedMLOD(shape, options);
+				if (!verified) {
+					global.files_ok--;
+					return 4;
 				}
-
-				// Close LOD
-				WriteName<64>(out, "#EndOfFile#");
-				out.write(fp::to_bytes(static_cast<uint32_t>(0)));
-				out.write(fp::to_bytes(lodDistance));
+			}
+			
+			// An output linked by an earlier run must not be written through to the models linked to it
+			if (dedupe) {
+				std::error_code error;
+				fs::remove(filename_mlod, error);
+			}
+			
+			fp::file out(filename_mlod.c_str(), "wb");
+			global.files_to_skip.push_back(filename_mlod);
+			
+			if (stream)
+				WriteMLODStreamed(out, file, shape, FieldMaskFromOptions(options), options);
+			else if (verified)
+				out.write(verified->data(), verified->size());
+			else
+				WriteMLOD(out, shape, options);
+		}
+		
+		if (server && write) {
+			if (!StripShapeForServer(shape, options)) {
+				global.files_ok--;
+				return 4;
+			}
+			
+			fp::file out(filename_server.c_str(), "wb");
+			global.files_to_skip.push_back(filename_server);
+			WriteODOL(out, shape);
+		}
+		
+		if (binarize && write) {
+			try {
+				fs::copy_file(filename_input, filename_odol, fs::copy_options::overwrite_existing);
+				global.files_to_skip.push_back(filename_odol);
+			} catch (const fs::filesystem_error& e) {
+				std::cout << "Failed to copy file: " << e.what() << std::endl;
 			}
 		}
 	} 
@@ -1466,45 +5620,21 @@ int Parse_P3D(std::string filename_input, std::string file_info, int &options) {
 		if (options & OPTION_INFO) {
 			ShapeMLOD shape(file);
 
-			if (options & OPTION_TEXTURE_LIST) {
-				if (~options & OPTION_TEXTURE_LIST_SINGLE) {
-					out << filename_input << std::endl << std::endl;
-					global.texture_list.clear();
-				}
-				bool output_lod_name = false;
+			if (options & OPTION_PROBE) {
+				// MLOD has no trailer so the special LOD indices, mass and armor are left empty
+				out << 
+				filename_input << "\t" << 
+				FormatSignature(current_file_signature) << "\t" << 
+				shape.version << "\t" << 
+				shape.lod_count << "\t";
 				
-				for (size_t i=0; i<shape.lods.size(); i++) {
-					LodShapeMLOD *l = &shape.lods[i];
-					
-					if (options & OPTION_TEXTURE_LIST_LODS) {
-						output_lod_name = true;
-						global.texture_list.clear();
-					}
-					
-					for (size_t j=0; j<l->faces.size(); j++) {
-						bool already_added = false;
-						
-						if (l->faces[j].texture.empty()) 
-							continue;
-						
-						for (size_t k=0; k<global.texture_list.size() && !already_added; k++)
-							if (strcasecmp(global.texture_list[k].c_str(),l->faces[j].texture.c_str()) == 0)
-								already_added = true;
-					
-						if (!already_added) {
-							if (output_lod_name) {
-								output_lod_name = false;
-								out << "LOD: " << FormatLodType(l->resolution) << std::endl;
-							}
-							
-							if (~options & OPTION_TEXTURE_LIST_SINGLE)
-								out << (options & OPTION_TEXTURE_LIST_LODS ? "\t" : "") <<	l->faces[j].texture << std::endl;
-							
-							global.texture_list.push_back(l->faces[j].texture);
-						}
-					}
-				}
-			} else {
+				for (size_t i=0; i<shape.lods.size(); i++)
+					out << (i>0 ? "," : "") << FormatLodType(shape.lods[i].resolution);
+				
+				out << "\t\t\t" << std::endl;
+			}
+			
+			if (options & OPTION_INFO_REPORT) {
 				out << 
 				filename_input << " - " << file_info << std::endl << std::endl <<
 				"Signature: "<< FormatSignature(current_file_signature) << std::endl << 
@@ -1644,15 +5774,70 @@ int Parse_P3D(std::string filename_input, std::string file_info, int &options) {
 					}
 				}
 			}
-		} 
-		else {
-			filename_output = CreateOutPath(filename_input);
-    
-			try {
-				fs::copy_file(filename_input, filename_output, fs::copy_options::overwrite_existing);
-				global.files_to_skip.push_back(filename_output);
-			} catch (const fs::filesystem_error& e) {
-				std::cout << "Failed to copy file: " << e.what() << std::endl;
+			
+			if (options & OPTION_TEXTURE_LIST) {
+				if (options & OPTION_INFO_REPORT && ~options & OPTION_TEXTURE_LIST_SINGLE)
+					out << std::endl << std::endl;
+				
+				if (~options & OPTION_TEXTURE_LIST_SINGLE) {
+					out << filename_input << std::endl << std::endl;
+					global.texture_list.clear();
+				}
+				bool output_lod_name = false;
+				
+				for (size_t i=0; i<shape.lods.size(); i++) {
+					LodShapeMLOD *l = &shape.lods[i];
+					
+					if (options & OPTION_TEXTURE_LIST_LODS) {
+						output_lod_name = true;
+						global.texture_list.clear();
+					}
+					
+					for (size_t j=0; j<l->faces.size(); j++) {
+						bool already_added = false;
+						
+						if (l->faces[j].texture.empty()) 
+							continue;
+						
+						for (size_t k=0; k<global.texture_list.size() && !already_added; k++)
+							if (strcasecmp(global.texture_list[k].c_str(),l->faces[j].texture.c_str()) == 0)
+								already_added = true;
+					
+						if (!already_added) {
+							if (output_lod_name) {
+								output_lod_name = false;
+								out << "LOD: " << FormatLodType(l->resolution) << std::endl;
+							}
+							
+							if (~options & OPTION_TEXTURE_LIST_SINGLE)
+								out << (options & OPTION_TEXTURE_LIST_LODS ? "\t" : "") <<	l->faces[j].texture << std::endl;
+							
+							global.texture_list.push_back(l->faces[j].texture);
+						}
+					}
+				}
+			}
+		}
+		
+		if ((~options & OPTION_INFO || options & OPTION_CONVERT) && ~options & OPTION_DEDUPE_REPORT) {
+			if (binarize) {
+				file.seek(sizeof(current_file_signature), SEEK_SET);
+				const auto shape = BinarizeMLOD(ShapeMLOD(file));
+				if (!shape) {
+					global.files_ok--;
+					return 4;
+				}
+				
+				fp::file out(filename_odol.c_str(), "wb");
+				global.files_to_skip.push_back(filename_odol);
+				WriteODOL(out, *shape);
+			} else {
+				try {
+					fs::copy_file(filename_input, filename_mlod, fs::copy_options::overwrite_existing);
+					global.files_to_skip.push_back(filename_mlod);
+				} catch (const fs::filesystem_error& e) {
+					std::cout << "Failed to copy file: " << e.what() << std::endl;
+				}
 			}
 		}
 	}
@@ -1748,9 +5933,12 @@ int ScanDirectory(const std::string& path, int &options) {
 					
 					if (file_ok) {
 						global.files_total++;
-						Parse_P3D(entry.path().string(), 
-									FormatFileInfo(entry), 
-									options);
+						if (options & OPTION_LINT)
+							global.lint_files.emplace_back(entry.path().string(), FormatFileInfo(entry));
+						else
+							Parse_P3D(entry.path().string(), 
+										FormatFileInfo(entry), 
+										options);
 					}
 				}
 			}
@@ -1762,14 +5950,98 @@ int ScanDirectory(const std::string& path, int &options) {
 	}
 }
 
+// Lints the queued models in parallel, one model per worker at a time, then writes odol2mlod_lint.txt with a
+// tab separated line per problem (or an ok line per clean model) and converts the clean models when -c is given
+int LintFiles(int options) {
+	const auto& files = global.lint_files;
+	std::vector<std::vector<LintProblem>> problems(files.size());
+	std::vector<uint8_t> skipped(files.size(), 0u);
+
+	ParallelFor(files.size(), 1u, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			fp::file file(files[i].first, "rb");
+			if (!file.is_open()) {
+				problems[i].push_back({-1, "-", "open", 1u, 0u, "error " + std::to_string(errno)});
+				continue;
+			}
+
+			uint32_t signature = 0u;
+			ReadValue(signature, file);
+			if (signature == signature_mlod) {
+				skipped[i] = 1u;
+			} else if (signature != signature_odol) {
+				problems[i].push_back({-1, "-", "signature", 1u, 0u, FormatSignature(signature)});
+			} else {
+				read_errors_throw = true;
+				try {
+					problems[i] = LintShape(Shape(file));
+				} catch (const std::exception& e) {
+					problems[i].push_back({-1, "-", "decode", 1u, 0u, std::string(e.what()) + " at byte " + std::to_string(file.tell())});
+				}
+				read_errors_throw = false;
+			}
+		}
+	});
+
+	std::fstream out;
+	out.open("odol2mlod_lint.txt", std::ios::out | std::ios::trunc);
+	if (!out.is_open()) {
+		std::cout << "Failed to create file odol2mlod_lint.txt - error " << errno << ": " << strerror(errno) << std::endl;
+		return 1;
+	}
+
+	out << "file\tlod\tresolution\tcheck\tcount\tfirst\tdetail" << std::endl;
+	size_t rejected = 0u;
+	for (size_t i = 0u; i < files.size(); ++i) {
+		const auto& path = files[i].first;
+		std::cout << path << std::endl;
+
+		if (skipped[i]) {
+			std::cout << "Lint: skipped, not an ODOL model" << std::endl;
+			out << path << "\t-\t-\tskipped\t0\t0\t" << std::endl;
+		} else if (problems[i].empty()) {
+			out << path << "\t-\t-\tok\t0\t0\t" << std::endl;
+		} else {
+			++rejected;
+		}
+
+		for (const auto& problem : problems[i]) {
+			std::cout << "Lint: " << (problem.lod >= 0 ? "LOD " + problem.resolution + ": " : "") << problem.check << " " <<
+				problem.count << " (first " << problem.first << ")" << (problem.detail.empty() ? "" : " " + problem.detail) << std::endl;
+			out << path << "\t" << (problem.lod >= 0 ? std::to_string(problem.lod) : "-") << "\t" << problem.resolution << "\t" <<
+				problem.check << "\t" << problem.count << "\t" << problem.first << "\t" << problem.detail << std::endl;
+		}
+	}
+	out.close();
+	std::cout << "Models with problems: " << rejected << "/" << files.size() << std::endl;
+
+	int result = rejected > 0u ? 3 : 0;
+	for (size_t i = 0u; i < files.size(); ++i) {
+		if (!problems[i].empty()) {
+			continue;
+		}
+		if (options & OPTION_CONVERT) {
+			if (Parse_P3D(files[i].first, files[i].second, options) != 0)
+				result = 3;
+		} else if (!skipped[i]) {
+			global.files_ok++;
+		}
+	}
+	return result;
+}
+
 int main(int argc, char* argv[]) {
 	int return_value = 0;
+	SelectKernels();
+	SelectWorkerThreads();
+	SelectWeldEpsilon();
     
     if (argc < 2) {
         std::cout << 
         "odol2mlod v1.01 by Miki and Faguss (ofp-faguss.com)" << std::endl <<
         "Converts OFP/CWA P3D model from the ODOL format to the MLOD format" << std::endl << std::endl <<
-        "Usage: odol2mlod [options] <file or dir> ..." << std::endl << std::endl <<
+        "Usage: odol2mlod [options] <file or dir> ..." << std::endl <<
+        "       odol2mlod -f [options] <file or dir> <file or dir>" << std::endl << std::endl <<
         "Options:" << std::endl << 
         "\t-m merge vertices (instead of splitting them)" << std::endl << 
         "\t-M merge vertices only for the functional lods and not the graphical ones" << std::endl << 
@@ -1780,17 +6052,42 @@ int main(int argc, char* argv[]) {
         "\t-s create a single info file (instead of one for each model)" << std::endl << 
         "\t-t create info file only with a texture list" << std::endl <<
         "\t-T create info file only with a texture list from each LOD" << std::endl <<
-        "\t-l create single info only with a texture list without p3d names" << std::endl;
+        "\t-l create single info only with a texture list without p3d names" << std::endl <<
+        "\t-p create info file only with a one line record read from the model trailer" << std::endl <<
+        "\t-c convert as well when creating info files (all outputs from a single read)" << std::endl <<
+        "\t-n write each distinct normal once per LOD (instead of one per face corner)" << std::endl <<
+        "\t-w weld vertices closer than 0.001 with the same flags and selections" << std::endl <<
+        "\t-d drop points that no face or selection uses" << std::endl <<
+        "\t-e add #SharpEdges# where the vertex normals of neighbouring faces differ" << std::endl <<
+        "\t-o order the faces of each LOD by texture and face flags" << std::endl <<
+        "\t-v as -o, then order the faces of each texture for the vertex cache" << std::endl <<
+        "\t-D add LODs with 50% and 25% of the faces of the last graphical LOD" << std::endl <<
+        "\t-g split the geometry LOD into component selections and report the ones that are not convex" << std::endl <<
+        "\t-G as -g, and replace the components that are not convex by their convex hull" << std::endl <<
+        "\t-f compare two models or two directories of models LOD by LOD (instead of converting)" << std::endl <<
+        "\t-k convert one of each group of identical models and hard link the others to it" << std::endl <<
+        "\t-K only list the groups of identical models (instead of converting)" << std::endl <<
+        "\t-b convert MLOD models to ODOL (instead of ODOL to MLOD)" << std::endl <<
+        "\t-S write ODOL models without their graphical LODs for dedicated servers (instead of converting)" << std::endl <<
+        "\t-X as -S, and drop empty selections and the animation phases outside the geometry and fire geometry LODs" << std::endl <<
+        "\t--verify read every converted model back and compare it with the source before saving it" << std::endl <<
+        "\t--lint check the models for broken indices and values (instead of converting), with -c convert the clean ones" << std::endl;
         return_value = 1;
     } else {
         int options = OPTION_NONE;
+        std::vector<std::string> diff_paths;
         
         for (int i=1; i<argc; i++) {
-            if (argv[i][0] == '-') {
+            if (std::strcmp(argv[i], "--verify") == 0) {
+                options |= OPTION_VERIFY;
+            } else if (std::strcmp(argv[i], "--lint") == 0) {
+                options |= OPTION_LINT;
+            } else if (argv[i][0] == '-') {
                 for (int j=1; argv[i][j]!='\0'; j++) {
                     switch(argv[i][j]) {
-                        case 'i' : options |= OPTION_INFO; break;
-                        case 'I' : options |= OPTION_INFO | OPTION_INFO_FULL; break;
+                        case 'i' : options |= OPTION_INFO | OPTION_INFO_REPORT; break;
+                        case 'I' : options |= OPTION_INFO | OPTION_INFO_REPORT | OPTION_INFO_FULL; break;
+                        case 'c' : options |= OPTION_CONVERT; break;
                         case 'r' : options |= OPTION_RECURSIVE; break;
                         case 's' : options |= OPTION_SINGLELOG | OPTION_TRUNCATE; break;
                         case 'm' : options |= OPTION_MERGE_POINTS; break;
@@ -1799,8 +6096,26 @@ int main(int argc, char* argv[]) {
                         case 't' : options |= OPTION_INFO | OPTION_TEXTURE_LIST; break;
                         case 'T' : options |= OPTION_INFO | OPTION_TEXTURE_LIST | OPTION_TEXTURE_LIST_LODS; break;
                         case 'l' : options |= OPTION_SINGLELOG | OPTION_TRUNCATE | OPTION_INFO | OPTION_TEXTURE_LIST | OPTION_TEXTURE_LIST_SINGLE; break;
+                        case 'p' : options |= OPTION_INFO | OPTION_PROBE; break;
+                        case 'n' : options |= OPTION_UNIQUE_NORMALS; break;
+                        case 'w' : options |= OPTION_WELD_POINTS; break;
+                        case 'd' : options |= OPTION_DROP_UNUSED_POINTS; break;
+                        case 'e' : options |= OPTION_SHARP_EDGES; break;
+                        case 'o' : options |= OPTION_SORT_FACES; break;
+                        case 'v' : options |= OPTION_VERTEX_CACHE; break;
+                        case 'D' : options |= OPTION_DECIMATE; break;
+                        case 'g' : options |= OPTION_CONVEX_COMPONENTS; break;
+                        case 'G' : options |= OPTION_CONVEX_HULLS; break;
+                        case 'f' : options |= OPTION_DIFF; break;
+                        case 'k' : options |= OPTION_DEDUPE; break;
+                        case 'K' : options |= OPTION_DEDUPE | OPTION_DEDUPE_REPORT; break;
+                        case 'b' : options |= OPTION_BINARIZE; break;
+                        case 'S' : options |= OPTION_SERVER; break;
+                        case 'X' : options |= OPTION_SERVER | OPTION_SERVER_STRIP; break;
                     }
                 }
+            } else if (options & OPTION_DIFF) {
+                diff_paths.push_back(argv[i]);
             } else {
                 struct stat info;
                 if (stat(argv[i], &info) != 0) {
@@ -1825,7 +6140,9 @@ int main(int argc, char* argv[]) {
                         
                         if (ext == "p3d") {
                             fs::directory_entry entry(file_name);
-                            if (Parse_P3D(file_name, FormatFileInfo(entry), options) == 0) {
+                            if (options & OPTION_LINT) {
+                                global.lint_files.emplace_back(file_name, FormatFileInfo(entry));
+                            } else if (Parse_P3D(file_name, FormatFileInfo(entry), options) == 0) {
                                 return_value = 0;
                             } else {
                                 return_value = 3;
@@ -1836,6 +6153,40 @@ int main(int argc, char* argv[]) {
             }
         }
         
+        if (options & OPTION_LINT) {
+            return_value = LintFiles(options);
+        }
+
+        if (options & OPTION_DIFF) {
+            if (diff_paths.size() != 2) {
+                std::cout << "Diff needs two files or two directories" << std::endl;
+                return 1;
+            }
+
+            std::error_code error;
+            if (fs::is_directory(diff_paths[0], error) && fs::is_directory(diff_paths[1], error)) {
+                return_value = DiffDirectories(diff_paths[0], diff_paths[1], options);
+            } else {
+                return_value = DiffFiles(diff_paths[0], diff_paths[1], options);
+                if (return_value == 0) {
+                    std::cout << "Same models" << std::endl;
+                }
+            }
+        }
+
+        if (options & OPTION_DEDUPE) {
+            size_t duplicates = 0;
+            for (const auto& group : global.model_group_files) {
+                if (group.size() > 1) {
+                    std::cout << "Identical models:" << std::endl;
+                    for (const auto& path : group)
+                        std::cout << "\t" << path << std::endl;
+                    duplicates += group.size() - 1;
+                }
+            }
+            std::cout << "Duplicate models: " << duplicates << std::endl;
+        }
+
         if (options & OPTION_TEXTURE_LIST_SINGLE) {
             std::fstream out;
             out.open("odol2mlod_texture_list.txt", std::ios::out | std::ios::trunc);
@@ -431,7 +431,7 @@ public:
 			m_up.Interpolate(b.m_up, coef));
 	}
 
-private:
+	// axes as given, neither normalized nor made orthogonal (for tensors such as inertia)
 	constexpr Matrix3Base(
 		const Vector3Base<T>& aside,
 		const Vector3Base<T>& up,
@@ -442,6 +442,7 @@ private:
 		m_dir(dir)
 	{}
 
+private:
 	Vector3Base<T> m_aside;
 	Vector3Base<T> m_up;
 	Vector3Base<T> m_dir;
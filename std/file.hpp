@@ -11,6 +11,8 @@ public:
 	file() noexcept : m_file(nullptr) {}
 	file(const char* name, const char* flags) noexcept : m_file(std::fopen(name, flags)) {}
 	file(const std::string& name, const char* flags) noexcept : m_file(std::fopen(name.c_str(), flags)) {}
+	// takes ownership of an already open stream
+	explicit file(FILE* stream) noexcept : m_file(stream) {}
 
 	~file() noexcept { close_internal(); }
 
@@ -67,7 +69,7 @@ public:
 		static_assert(!std::is_const<typename U::value_type>::value, "Can not write into const objects.");
 		static_assert(std::is_trivially_destructible<typename U::value_type>::value,
 			"Raw serialization of objects with non default destructors is not allowed.");
-		if (!m_file) {
+		if (!m_file || container.size() == 0) {
 			return 0;
 		}
 		return std::fread(container.data(), 1, container.size() * sizeof(typename U::value_type), m_file);
@@ -78,20 +80,20 @@ public:
 		using U = std::decay_t<T>;
 		static_assert(std::is_trivially_destructible<typename U::value_type>::value,
 			"Raw serialization of objects with non default destructors is not allowed.");
-		if (!m_file) {
+		if (!m_file || container.size() == 0) {
 			return 0;
 		}
 		return std::fwrite(container.data(), 1, container.size() * sizeof(typename U::value_type), m_file);
 	}
 
 	size_t read(void* data, size_t size) noexcept {
-		if (!m_file) {
+		if (!m_file || size == 0) {
 			return 0;
 		}
 		return std::fread(data, 1, size, m_file);
 	}
 	size_t write(const void* data, size_t size) noexcept {
-		if (!m_file) {
+		if (!m_file || size == 0) {
 			return 0;
 		}
 		return std::fwrite(data, 1, size, m_file);